@@ -0,0 +1,234 @@
+// runs the compiles in a capture file (ShaderCompiler_SetCaptureFile) again and reports throughput, latency
+// and how the time per compile compares to when it was recorded. Includes come from the capture so a
+// session can be replayed without the project it came from. Compiles run N at a time in capture order,
+// when an include changes part way through everything before the change finishes first.
+// the result cache is off unless -cache is given. Without it each compile also gets a define of its own
+// (CAPTURE_REPLAY_COMPILE) so identical compiles running together don't coalesce, every compile is a real one.
+// usage: capture_replay <capture file> [-threads N] [-cache]
+#include "gfx_shadercompiler/compiler.h"
+#include "al2o3_vfile/memory.h"
+#include "capture.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+using ShaderCompiler::Capture;
+using ShaderCompiler::CaptureCompile;
+
+namespace {
+
+// the contents each include name has at this point in the capture, only changed between batches
+std::unordered_map<std::string, Capture::Include const *> includes;
+
+bool LoadInclude(void *userData, char const *filename, ShaderCompiler_IncludeData *out) {
+	auto it = includes.find(filename);
+	if (it == includes.end()) return false;
+	// the capture lives until the end of the run
+	out->data = it->second->contents.data();
+	out->size = it->second->contents.size();
+	out->release = nullptr;
+	out->owner = nullptr;
+	return true;
+}
+
+// compiles can only share a context if they have the same settings
+typedef std::tuple<uint32_t, uint32_t, uint32_t, uint32_t> Settings;
+
+struct Replay {
+	Capture capture;
+	bool useCache = false;
+	std::map<Settings, ShaderCompiler_ContextHandle> contexts;
+
+	// per compile
+	std::vector<double> milliseconds;
+	std::vector<uint8_t> succeeded;
+	std::vector<uint8_t> coalesced;
+
+	ShaderCompiler_ContextHandle Context(CaptureCompile const& compile) {
+		Settings const settings{compile.inputLanguage, compile.outputType, compile.outputVersion, compile.optimizationLevel};
+		auto it = contexts.find(settings);
+		if (it != contexts.end()) return it->second;
+
+		ShaderCompiler_ContextHandle ctx = ShaderCompiler_Create();
+		// outputs are freed with ShaderCompiler_FreeOutput, time the path without copies
+		ShaderCompiler_SetZeroCopyOutputs(ctx, true);
+		if (!useCache) ShaderCompiler_SetCacheBudget(ctx, 0);
+		ShaderCompiler_SetIncludeLoader(ctx, &LoadInclude, nullptr);
+		ShaderCompiler_SetLanguage(ctx, (ShaderCompiler_Language) compile.inputLanguage);
+		ShaderCompiler_SetOutput(ctx, (ShaderCompiler_OutputType) compile.outputType, compile.outputVersion);
+		ShaderCompiler_SetOptimizationLevel(ctx, (ShaderCompiler_Optimizations) compile.optimizationLevel);
+		contexts[settings] = ctx;
+		return ctx;
+	}
+
+	void CompileOne(ShaderCompiler_ContextHandle ctx, uint32_t index) {
+		CaptureCompile const& compile = capture.compiles[index];
+		std::string const& source = capture.sources.at(compile.source);
+
+		std::vector<ShaderCompiler_Define> defines(compile.defines.size());
+		for (size_t i = 0; i < defines.size(); ++i) {
+			defines[i].name = compile.defines[i].name.c_str();
+			defines[i].value = compile.defines[i].hasValue ? compile.defines[i].value.c_str() : nullptr;
+		}
+		char value[16];
+		if (!useCache) {
+			snprintf(value, sizeof(value), "%u", index);
+			defines.push_back({"CAPTURE_REPLAY_COMPILE", value});
+		}
+
+		// memory files are used in place and must be 0 terminated, std::string is
+		VFile_Handle file = VFile_FromMemory(source.c_str(), source.size(), false);
+		ShaderCompiler_OutputEx output;
+		auto const start = std::chrono::steady_clock::now();
+		bool const ok = ShaderCompiler_CompileEx(ctx, (ShaderCompiler_ShaderType) compile.shaderType,
+																						 compile.name.c_str(), compile.entryPoint.c_str(), file,
+																						 defines.data(), (uint32_t) defines.size(), &output);
+		milliseconds[index] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		succeeded[index] = ok;
+		coalesced[index] = output.coalesced;
+		// failures can still have a log
+		ShaderCompiler_FreeOutput(&output.output);
+		VFile_Close(file);
+	}
+
+	// compiles the batch threads at a time, returns when they are all done
+	void Run(std::vector<uint32_t> const& batch, uint32_t threads) {
+		if (batch.empty()) return;
+
+		// contexts are made up front, the worker threads only use them
+		std::vector<ShaderCompiler_ContextHandle> batchContexts(batch.size());
+		for (size_t i = 0; i < batch.size(); ++i) {
+			batchContexts[i] = Context(capture.compiles[batch[i]]);
+		}
+
+		std::atomic<size_t> next(0);
+		auto worker = [&]() {
+			for (size_t i = next++; i < batch.size(); i = next++) {
+				CompileOne(batchContexts[i], batch[i]);
+			}
+		};
+
+		if (threads == 1) {
+			worker();
+		} else {
+			std::vector<std::thread> workers;
+			for (uint32_t i = 0; i < threads; ++i) workers.emplace_back(worker);
+			for (auto& thread : workers) thread.join();
+		}
+	}
+
+	void Invalidate(char const *name) {
+		for (auto const& context : contexts) {
+			ShaderCompiler_InvalidateInclude(context.second, name);
+		}
+	}
+};
+
+double Percentile(std::vector<double> const& sorted, double p) {
+	size_t const index = std::min(sorted.size() - 1, (size_t) (p * (double) (sorted.size() - 1) + 0.5));
+	return sorted[index];
+}
+
+} // end anon namespace
+
+int main(int argc, char const *argv[]) {
+	char const *path = nullptr;
+	uint32_t threads = std::thread::hardware_concurrency();
+	Replay replay;
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "-threads") && i + 1 < argc) {
+			threads = (uint32_t) atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "-cache")) {
+			replay.useCache = true;
+		} else {
+			path = argv[i];
+		}
+	}
+	if (threads == 0) threads = 1;
+	if (!path) {
+		printf("usage: capture_replay <capture file> [-threads N] [-cache]\n");
+		return 1;
+	}
+
+	Capture& capture = replay.capture;
+	if (!capture.Read(path)) {
+		if (capture.records.empty()) {
+			printf("couldn't read %s\n", path);
+			return 1;
+		}
+		printf("%s is cut short, replaying the %zu compiles before that\n", path, capture.compiles.size());
+	}
+	if (capture.compiles.empty()) {
+		printf("%s has no compiles\n", path);
+		return 1;
+	}
+	replay.milliseconds.resize(capture.compiles.size());
+	replay.succeeded.resize(capture.compiles.size());
+	replay.coalesced.resize(capture.compiles.size());
+
+	// runs of compiles that saw the same include contents, split where an include changed
+	uint32_t batches = 0;
+	std::vector<uint32_t> batch;
+	auto const start = std::chrono::steady_clock::now();
+	for (auto const& record : capture.records) {
+		if (record.type == Capture::Record::CompileRecord) {
+			batch.push_back(record.index);
+			continue;
+		}
+
+		Capture::Include const& include = capture.includes[record.index];
+		auto it = includes.find(include.name);
+		if (it == includes.end()) {
+			includes[include.name] = &include;
+		} else if (it->second->contentHash != include.contentHash) {
+			replay.Run(batch, threads);
+			batch.clear();
+			batches++;
+			it->second = &include;
+			replay.Invalidate(include.name.c_str());
+		}
+	}
+	replay.Run(batch, threads);
+	batches++;
+	double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<double> latencies = replay.milliseconds;
+	std::sort(latencies.begin(), latencies.end());
+	double recorded = 0.0, replayed = 0.0;
+	uint32_t failed = 0, changed = 0, coalesced = 0;
+	for (size_t i = 0; i < capture.compiles.size(); ++i) {
+		if (replay.coalesced[i]) coalesced++;
+		recorded += (double) capture.compiles[i].durationNs / 1e6;
+		replayed += replay.milliseconds[i];
+		if (!replay.succeeded[i]) failed++;
+		if ((replay.succeeded[i] != 0) != capture.compiles[i].succeeded) changed++;
+	}
+	size_t const count = capture.compiles.size();
+
+	printf("%zu compiles (%zu distinct sources, %zu include loads, %u batches, %zu settings) %u threads\n",
+				 count, capture.sources.size(), capture.includes.size(), batches, replay.contexts.size(), threads);
+	printf("%.3f s  %.1f compiles/s  p50 %.2f  p90 %.2f  p99 %.2f  max %.2f ms\n",
+				 seconds, (double) count / seconds,
+				 Percentile(latencies, 0.5), Percentile(latencies, 0.9), Percentile(latencies, 0.99), latencies.back());
+	printf("per compile: recorded %.2f ms  replayed %.2f ms  (%.2fx)\n",
+				 recorded / (double) count, replayed / (double) count, recorded > 0.0 ? replayed / recorded : 0.0);
+	if (failed) printf("%u failed", failed);
+	if (changed) printf("%s%u succeeded or failed differently to the capture", failed ? ", " : "", changed);
+	if (failed || changed) printf("\n");
+	// only with -cache, a waiter's time is how long it waited for another compile
+	if (coalesced) printf("%u waited for an identical compile\n", coalesced);
+
+	for (auto const& context : replay.contexts) {
+		ShaderCompiler_Destroy(context.second);
+	}
+	return 0;
+}
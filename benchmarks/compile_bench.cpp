@@ -0,0 +1,221 @@
+// end to end compile throughput and latency over the corpus in benchmarks/corpus, for each output type
+// single threaded and at N threads, with where the time went from ShaderCompiler_CompileEx.
+// the result cache is off and every timed compile has a define of its own (COMPILE_BENCH_SAMPLE) so none
+// share another's result by coalescing with it, every compile is a real one. Includes are cached per context
+// as in real use.
+// usage: compile_bench [corpus directory] [-threads N] [-rounds N]
+#include "gfx_shadercompiler/compiler.h"
+#include "al2o3_vfile/memory.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef COMPILE_BENCH_CORPUS
+#define COMPILE_BENCH_CORPUS "benchmarks/corpus"
+#endif
+
+namespace {
+
+struct Shader {
+	char const *file;
+	ShaderCompiler_ShaderType type;
+	std::string source;
+};
+
+struct Output {
+	char const *name;
+	ShaderCompiler_OutputType type;
+};
+
+Output const Outputs[] = {
+		{"SPIRV", ShaderCompiler_OT_SPIRV},
+		{"DXIL", ShaderCompiler_OT_DXIL},
+		{"HLSL", ShaderCompiler_OT_HLSL},
+		{"GLSL", ShaderCompiler_OT_GLSL},
+		{"MSL_OSX", ShaderCompiler_OT_MSL_OSX},
+		{"MSL_IOS", ShaderCompiler_OT_MSL_IOS},
+};
+
+std::map<std::string, std::string> includes;
+
+bool ReadFile(std::string const& path, std::string& out) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) return false;
+	std::stringstream contents;
+	contents << file.rdbuf();
+	out = contents.str();
+	return true;
+}
+
+bool LoadInclude(void *userData, char const *filename, ShaderCompiler_IncludeData *out) {
+	auto it = includes.find(filename);
+	if (it == includes.end()) return false;
+	// lives until the end of the run
+	out->data = it->second.data();
+	out->size = it->second.size();
+	out->release = nullptr;
+	out->owner = nullptr;
+	return true;
+}
+
+struct Sample {
+	double milliseconds;
+	ShaderCompiler_Timings timings;
+	bool coalesced;
+};
+
+// false if it failed. index (if not ~0) goes in a define so the compile is distinct from any other running
+bool CompileOne(ShaderCompiler_ContextHandle ctx, Shader const& shader, uint32_t index, Sample& sample) {
+	char value[16];
+	snprintf(value, sizeof(value), "%u", index);
+	ShaderCompiler_Define const define{"COMPILE_BENCH_SAMPLE", value};
+	uint32_t const defineCount = (index != ~0u) ? 1 : 0;
+
+	// memory files are used in place and must be 0 terminated, std::string is
+	VFile_Handle file = VFile_FromMemory(shader.source.c_str(), shader.source.size(), false);
+	ShaderCompiler_OutputEx output;
+	auto const start = std::chrono::steady_clock::now();
+	bool const ok = ShaderCompiler_CompileEx(ctx, shader.type, shader.file, "main", file, &define, defineCount, &output);
+	sample.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	sample.timings = output.timings;
+	sample.coalesced = output.coalesced;
+	ShaderCompiler_FreeOutput(&output.output);
+	VFile_Close(file);
+	return ok;
+}
+
+double Percentile(std::vector<double> const& sorted, double p) {
+	size_t const index = std::min(sorted.size() - 1, (size_t) (p * (double) (sorted.size() - 1) + 0.5));
+	return sorted[index];
+}
+
+void Report(char const *output, uint32_t threads, std::vector<Sample> const& samples, double seconds, uint32_t failed) {
+	std::vector<double> latencies;
+	latencies.reserve(samples.size());
+	double frontEnd = 0.0, conversion = 0.0, includes = 0.0;
+	uint32_t coalesced = 0;
+	for (auto const& sample : samples) {
+		// shouldn't happen with the per sample define, but a waiter's time isn't a compile's so say so
+		if (sample.coalesced) coalesced++;
+		latencies.push_back(sample.milliseconds);
+		frontEnd += (double) sample.timings.frontEnd;
+		conversion += (double) (sample.timings.spirvParse + sample.timings.conversion);
+		includes += (double) sample.timings.includes;
+	}
+	std::sort(latencies.begin(), latencies.end());
+	double const perCompile = 1e6 * (double) samples.size();
+
+	printf("%-8s %3u threads %8.1f shaders/s  p50 %7.2f  p90 %7.2f  p99 %7.2f  max %7.2f ms"
+				 "  | dxc %7.2f  cross %7.2f  includes %6.3f ms/shader",
+				 output, threads, (double) samples.size() / seconds,
+				 Percentile(latencies, 0.5), Percentile(latencies, 0.9), Percentile(latencies, 0.99), latencies.back(),
+				 frontEnd / perCompile, conversion / perCompile, includes / perCompile);
+	if (failed) printf("  (%u failed)", failed);
+	if (coalesced) printf("  (%u coalesced)", coalesced);
+	printf("\n");
+}
+
+void Run(ShaderCompiler_ContextHandle ctx, Output const& output, std::vector<Shader const *> const& shaders,
+				 uint32_t threads, uint32_t rounds) {
+	uint32_t const total = (uint32_t) shaders.size() * rounds;
+	std::vector<Sample> samples(total);
+	std::atomic<uint32_t> next(0);
+	std::atomic<uint32_t> failed(0);
+
+	auto worker = [&]() {
+		for (uint32_t i = next++; i < total; i = next++) {
+			if (!CompileOne(ctx, *shaders[i % shaders.size()], i, samples[i])) failed++;
+		}
+	};
+
+	auto const start = std::chrono::steady_clock::now();
+	if (threads == 1) {
+		worker();
+	} else {
+		std::vector<std::thread> workers;
+		for (uint32_t i = 0; i < threads; ++i) workers.emplace_back(worker);
+		for (auto& thread : workers) thread.join();
+	}
+	double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	Report(output.name, threads, samples, seconds, failed);
+}
+
+} // end anon namespace
+
+int main(int argc, char const *argv[]) {
+	std::string corpus = COMPILE_BENCH_CORPUS;
+	uint32_t threads = std::thread::hardware_concurrency();
+	uint32_t rounds = 4;
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "-threads") && i + 1 < argc) {
+			threads = (uint32_t) atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "-rounds") && i + 1 < argc) {
+			rounds = (uint32_t) atoi(argv[++i]);
+		} else {
+			corpus = argv[i];
+		}
+	}
+	if (threads == 0) threads = 1;
+	if (rounds == 0) rounds = 1;
+
+	std::vector<Shader> shaders = {
+			{"standard_vs.hlsl", ShaderCompiler_ST_VertexShader, {}},
+			{"standard_ps.hlsl", ShaderCompiler_ST_FragmentShader, {}},
+			{"blur_cs.hlsl", ShaderCompiler_ST_ComputeShader, {}},
+			{"terrain_hs.hlsl", ShaderCompiler_ST_TessControlShader, {}},
+			{"terrain_ds.hlsl", ShaderCompiler_ST_TessEvaluationShader, {}},
+	};
+	for (auto& shader : shaders) {
+		if (!ReadFile(corpus + "/" + shader.file, shader.source)) {
+			printf("couldn't read %s/%s\n", corpus.c_str(), shader.file);
+			return 1;
+		}
+	}
+	for (char const *name : {"common.hlsli", "lighting.hlsli", "tessellation.hlsli"}) {
+		if (!ReadFile(corpus + "/" + name, includes[name])) {
+			printf("couldn't read %s/%s\n", corpus.c_str(), name);
+			return 1;
+		}
+	}
+
+	ShaderCompiler_ContextHandle ctx = ShaderCompiler_Create();
+	// outputs are freed with ShaderCompiler_FreeOutput, time the path without copies
+	ShaderCompiler_SetZeroCopyOutputs(ctx, true);
+	ShaderCompiler_SetCacheBudget(ctx, 0);
+	ShaderCompiler_SetIncludeLoader(ctx, &LoadInclude, nullptr);
+
+	for (auto const& output : Outputs) {
+		ShaderCompiler_SetOutput(ctx, output.type, 0);
+
+		// a warm up compile of each shader, which also drops those the output doesn't support
+		// (SPIRV-Cross has no HLSL hull or domain shaders for example)
+		std::vector<Shader const *> supported;
+		for (auto const& shader : shaders) {
+			Sample sample;
+			if (CompileOne(ctx, shader, ~0u, sample)) {
+				supported.push_back(&shader);
+			} else {
+				printf("%-8s %s isn't supported, skipped\n", output.name, shader.file);
+			}
+		}
+		if (supported.empty()) continue;
+
+		Run(ctx, output, supported, 1, rounds);
+		if (threads > 1) {
+			Run(ctx, output, supported, threads, rounds * threads);
+		}
+	}
+
+	ShaderCompiler_Destroy(ctx);
+	return 0;
+}
@@ -0,0 +1,42 @@
+#include "common.hlsli"
+
+#define GROUP_SIZE 64
+#define RADIUS 8
+
+Texture2D<float4> inputTexture : register(t0);
+RWTexture2D<float4> outputTexture : register(u0);
+
+cbuffer BlurConstants : register(b1)
+{
+	float weights[RADIUS + 1];
+	uint2 imageSize;
+};
+
+groupshared float4 cache[GROUP_SIZE + 2 * RADIUS];
+
+[numthreads(GROUP_SIZE, 1, 1)]
+void main(uint3 groupId : SV_GroupID, uint3 threadId : SV_DispatchThreadID, uint index : SV_GroupIndex)
+{
+	int2 coord = int2(threadId.xy);
+	int2 clampMax = int2(imageSize) - 1;
+
+	cache[index + RADIUS] = inputTexture[clamp(coord, int2(0, 0), clampMax)];
+	if (index < RADIUS)
+	{
+		cache[index] = inputTexture[clamp(coord - int2(RADIUS, 0), int2(0, 0), clampMax)];
+		cache[index + GROUP_SIZE + RADIUS] = inputTexture[clamp(coord + int2(GROUP_SIZE, 0), int2(0, 0), clampMax)];
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	float4 sum = cache[index + RADIUS] * weights[0];
+	[unroll]
+	for (int i = 1; i <= RADIUS; ++i)
+	{
+		sum += (cache[index + RADIUS - i] + cache[index + RADIUS + i]) * weights[i];
+	}
+
+	if (all(threadId.xy < imageSize))
+	{
+		outputTexture[threadId.xy] = sum;
+	}
+}
@@ -0,0 +1,44 @@
+#ifndef COMMON_HLSLI
+#define COMMON_HLSLI
+
+cbuffer FrameConstants : register(b0)
+{
+	float4x4 viewProjection;
+	float4x4 world;
+	float3 cameraPosition;
+	float time;
+	float3 sunDirection;
+	float exposure;
+	float3 sunColour;
+	float displacementScale;
+};
+
+struct VertexInput
+{
+	float3 position : POSITION;
+	float3 normal : NORMAL;
+	float4 tangent : TANGENT;
+	float2 uv : TEXCOORD0;
+};
+
+struct PixelInput
+{
+	float4 position : SV_Position;
+	float3 worldPosition : POSITION1;
+	float3 normal : NORMAL;
+	float4 tangent : TANGENT;
+	float2 uv : TEXCOORD0;
+};
+
+float3 UnpackNormal(float2 xy)
+{
+	xy = xy * 2.0 - 1.0;
+	return float3(xy, sqrt(saturate(1.0 - dot(xy, xy))));
+}
+
+float Luminance(float3 colour)
+{
+	return dot(colour, float3(0.2126, 0.7152, 0.0722));
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef LIGHTING_HLSLI
+#define LIGHTING_HLSLI
+
+#include "common.hlsli"
+
+static const float PI = 3.14159265;
+#define MAX_LIGHTS 16
+
+struct PointLight
+{
+	float3 position;
+	float radius;
+	float3 colour;
+	float intensity;
+};
+
+cbuffer LightConstants : register(b1)
+{
+	PointLight lights[MAX_LIGHTS];
+	uint lightCount;
+	float3 ambient;
+};
+
+float DistributionGGX(float NdotH, float roughness)
+{
+	float a = roughness * roughness;
+	float a2 = a * a;
+	float d = NdotH * NdotH * (a2 - 1.0) + 1.0;
+	return a2 / (PI * d * d);
+}
+
+float GeometrySchlickGGX(float NdotV, float roughness)
+{
+	float r = roughness + 1.0;
+	float k = (r * r) / 8.0;
+	return NdotV / (NdotV * (1.0 - k) + k);
+}
+
+float3 FresnelSchlick(float cosTheta, float3 F0)
+{
+	return F0 + (1.0 - F0) * pow(saturate(1.0 - cosTheta), 5.0);
+}
+
+float3 EvaluateLight(float3 N, float3 V, float3 L, float3 radiance, float3 albedo, float metallic, float roughness)
+{
+	float3 H = normalize(V + L);
+	float NdotL = saturate(dot(N, L));
+	float NdotV = saturate(dot(N, V)) + 1e-4;
+	float3 F0 = lerp(float3(0.04, 0.04, 0.04), albedo, metallic);
+
+	float D = DistributionGGX(saturate(dot(N, H)), roughness);
+	float G = GeometrySchlickGGX(NdotV, roughness) * GeometrySchlickGGX(NdotL, roughness);
+	float3 F = FresnelSchlick(saturate(dot(H, V)), F0);
+
+	float3 specular = (D * G * F) / (4.0 * NdotV * NdotL + 1e-4);
+	float3 kD = (1.0 - F) * (1.0 - metallic);
+	return (kD * albedo / PI + specular) * radiance * NdotL;
+}
+
+#endif
@@ -0,0 +1,44 @@
+#include "lighting.hlsli"
+
+Texture2D albedoTexture : register(t0);
+Texture2D normalTexture : register(t1);
+Texture2D materialTexture : register(t2);
+TextureCube environmentTexture : register(t3);
+SamplerState materialSampler : register(s0);
+
+float4 main(PixelInput input) : SV_Target
+{
+	float4 albedo = albedoTexture.Sample(materialSampler, input.uv);
+	float3 material = materialTexture.Sample(materialSampler, input.uv).rgb;
+	float metallic = material.r;
+	float roughness = max(material.g, 0.05);
+	float occlusion = material.b;
+
+	float3 N = normalize(input.normal);
+	float3 T = normalize(input.tangent.xyz - N * dot(input.tangent.xyz, N));
+	float3 B = cross(N, T) * input.tangent.w;
+	float3 tangentNormal = UnpackNormal(normalTexture.Sample(materialSampler, input.uv).xy);
+	N = normalize(mul(tangentNormal, float3x3(T, B, N)));
+
+	float3 V = normalize(cameraPosition - input.worldPosition);
+	float3 colour = EvaluateLight(N, V, -sunDirection, sunColour, albedo.rgb, metallic, roughness);
+
+	[loop]
+	for (uint i = 0; i < lightCount; ++i)
+	{
+		float3 toLight = lights[i].position - input.worldPosition;
+		float distance = length(toLight);
+		float attenuation = saturate(1.0 - distance / lights[i].radius);
+		attenuation *= attenuation;
+		float3 radiance = lights[i].colour * lights[i].intensity * attenuation;
+		colour += EvaluateLight(N, V, toLight / distance, radiance, albedo.rgb, metallic, roughness);
+	}
+
+	float3 R = reflect(-V, N);
+	float3 environment = environmentTexture.SampleLevel(materialSampler, R, roughness * 8.0).rgb;
+	colour += (ambient * albedo.rgb + environment * FresnelSchlick(saturate(dot(N, V)), lerp(0.04, albedo.rgb, metallic))) * occlusion;
+
+	colour *= exposure;
+	colour = colour / (1.0 + Luminance(colour));
+	return float4(colour, albedo.a);
+}
@@ -0,0 +1,13 @@
+#include "common.hlsli"
+
+PixelInput main(VertexInput input)
+{
+	PixelInput output;
+	float4 worldPosition = mul(world, float4(input.position, 1.0));
+	output.position = mul(viewProjection, worldPosition);
+	output.worldPosition = worldPosition.xyz;
+	output.normal = normalize(mul((float3x3) world, input.normal));
+	output.tangent = float4(normalize(mul((float3x3) world, input.tangent.xyz)), input.tangent.w);
+	output.uv = input.uv;
+	return output;
+}
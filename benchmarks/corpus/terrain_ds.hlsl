@@ -0,0 +1,27 @@
+#include "tessellation.hlsli"
+
+Texture2D heightTexture : register(t0);
+SamplerState heightSampler : register(s0);
+
+[domain("tri")]
+PixelInput main(PatchConstants constants, float3 barycentric : SV_DomainLocation,
+								const OutputPatch<ControlPoint, 3> patch)
+{
+	float3 position = patch[0].position * barycentric.x + patch[1].position * barycentric.y +
+										patch[2].position * barycentric.z;
+	float3 normal = normalize(patch[0].normal * barycentric.x + patch[1].normal * barycentric.y +
+														patch[2].normal * barycentric.z);
+	float2 uv = patch[0].uv * barycentric.x + patch[1].uv * barycentric.y + patch[2].uv * barycentric.z;
+
+	float height = heightTexture.SampleLevel(heightSampler, uv, 0).r;
+	position += normal * height * displacementScale;
+
+	PixelInput output;
+	float4 worldPosition = mul(world, float4(position, 1.0));
+	output.position = mul(viewProjection, worldPosition);
+	output.worldPosition = worldPosition.xyz;
+	output.normal = normalize(mul((float3x3) world, normal));
+	output.tangent = float4(1.0, 0.0, 0.0, 1.0);
+	output.uv = uv;
+	return output;
+}
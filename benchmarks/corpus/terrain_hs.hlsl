@@ -0,0 +1,28 @@
+#include "tessellation.hlsli"
+
+float EdgeFactor(float3 a, float3 b)
+{
+	float3 centre = mul(world, float4((a + b) * 0.5, 1.0)).xyz;
+	float distance = length(cameraPosition - centre);
+	return clamp(64.0 / max(distance, 1.0), 1.0, 32.0);
+}
+
+PatchConstants PatchConstantFunction(InputPatch<ControlPoint, 3> patch)
+{
+	PatchConstants constants;
+	constants.edges[0] = EdgeFactor(patch[1].position, patch[2].position);
+	constants.edges[1] = EdgeFactor(patch[2].position, patch[0].position);
+	constants.edges[2] = EdgeFactor(patch[0].position, patch[1].position);
+	constants.inside = (constants.edges[0] + constants.edges[1] + constants.edges[2]) / 3.0;
+	return constants;
+}
+
+[domain("tri")]
+[partitioning("fractional_odd")]
+[outputtopology("triangle_cw")]
+[outputcontrolpoints(3)]
+[patchconstantfunc("PatchConstantFunction")]
+ControlPoint main(InputPatch<ControlPoint, 3> patch, uint id : SV_OutputControlPointID)
+{
+	return patch[id];
+}
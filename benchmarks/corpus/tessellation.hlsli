@@ -0,0 +1,19 @@
+#ifndef TESSELLATION_HLSLI
+#define TESSELLATION_HLSLI
+
+#include "common.hlsli"
+
+struct ControlPoint
+{
+	float3 position : POSITION;
+	float3 normal : NORMAL;
+	float2 uv : TEXCOORD0;
+};
+
+struct PatchConstants
+{
+	float edges[3] : SV_TessFactor;
+	float inside : SV_InsideTessFactor;
+};
+
+#endif
@@ -0,0 +1,114 @@
+// UTF-8 <-> wchar_t throughput, the transcoder against the setlocale + mbstowcs/wcstombs conversion the
+// non windows MultiByteToWideChar/WideCharToMultiByte used to do
+#include "utf_transcode.hpp"
+#include <chrono>
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+// what CPToLocale(CP_UTF8) gives, or the C UTF-8 locale on systems without it
+#ifdef __APPLE__
+char const *Utf8Locale = "en_US.UTF-8";
+#else
+char const *Utf8Locale = "en_US.utf8";
+#endif
+
+size_t LegacyUtf8ToWide(char const *src, size_t size, wchar_t *dst) {
+	char const *locale = setlocale(LC_ALL, Utf8Locale);
+	char *copy = (char *) malloc(size + 1);
+	memcpy(copy, src, size);
+	copy[size] = 0;
+	size_t const rv = mbstowcs(dst, copy, size + 1);
+	free(copy);
+	setlocale(LC_ALL, locale);
+	return rv;
+}
+
+size_t LegacyWideToUtf8(wchar_t const *src, size_t count, char *dst, size_t dstSize) {
+	char const *locale = setlocale(LC_ALL, Utf8Locale);
+	wchar_t *copy = (wchar_t *) malloc((count + 1) * sizeof(wchar_t));
+	memcpy(copy, src, count * sizeof(wchar_t));
+	copy[count] = 0;
+	size_t const rv = wcstombs(dst, copy, dstSize);
+	free(copy);
+	setlocale(LC_ALL, locale);
+	return rv;
+}
+
+template<typename F>
+double MegabytesPerSecond(size_t bytesPerCall, F const& call) {
+	using Clock = std::chrono::steady_clock;
+	// enough calls for ~0.25s
+	size_t calls = 0;
+	auto const start = Clock::now();
+	double seconds = 0.0;
+	do {
+		for (int i = 0; i < 64; ++i) call();
+		calls += 64;
+		seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	} while (seconds < 0.25);
+	return (double) (bytesPerCall * calls) / (seconds * 1024.0 * 1024.0);
+}
+
+void Run(char const *name, std::string const& text) {
+	std::vector<wchar_t> wide(ShaderCompiler::Utf8ToWideMaxLength(text.size()) + 1);
+	size_t const wideCount = ShaderCompiler::Utf8ToWide(text.data(), text.size(), wide.data());
+	if (wideCount == ShaderCompiler::TranscodeError) {
+		printf("%s: invalid UTF-8\n", name);
+		return;
+	}
+	std::vector<char> narrow(ShaderCompiler::WideToUtf8MaxLength(wideCount) + 1);
+
+	volatile size_t sink = 0;
+	double const legacyTo = MegabytesPerSecond(text.size(), [&]() {
+		sink = sink + LegacyUtf8ToWide(text.data(), text.size(), wide.data());
+	});
+	double const fastTo = MegabytesPerSecond(text.size(), [&]() {
+		sink = sink + ShaderCompiler::Utf8ToWide(text.data(), text.size(), wide.data());
+	});
+	double const legacyFrom = MegabytesPerSecond(text.size(), [&]() {
+		sink = sink + LegacyWideToUtf8(wide.data(), wideCount, narrow.data(), narrow.size());
+	});
+	double const fastFrom = MegabytesPerSecond(text.size(), [&]() {
+		sink = sink + ShaderCompiler::WideToUtf8(wide.data(), wideCount, narrow.data());
+	});
+
+	printf("%-22s %8zu bytes  to wide %9.1f -> %9.1f MB/s (x%5.1f)  to utf8 %9.1f -> %9.1f MB/s (x%5.1f)\n",
+				 name, text.size(),
+				 legacyTo, fastTo, fastTo / legacyTo,
+				 legacyFrom, fastFrom, fastFrom / legacyFrom);
+}
+
+} // end anon namespace
+
+int main() {
+	if (!setlocale(LC_ALL, Utf8Locale)) {
+		Utf8Locale = "C.UTF-8";
+		if (!setlocale(LC_ALL, Utf8Locale)) {
+			printf("no UTF-8 locale is installed, the legacy numbers would be meaningless\n");
+			return 1;
+		}
+	}
+	setlocale(LC_ALL, "C");
+
+	std::string source;
+	while (source.size() < 256 * 1024) {
+		source += "float4 main(float4 pos : SV_Position, float2 uv : TEXCOORD0) : SV_Target {\n"
+							"\treturn gTexture.Sample(gSampler, uv) * gConstants.tint; // modulate\n}\n";
+	}
+	std::string mixed;
+	while (mixed.size() < 256 * 1024) {
+		mixed += "// \xC3\xA9\xC3\xA8 commentaire \xE2\x80\x94 \xE6\xBC\xA2\xE5\xAD\x97 \xF0\x9F\x98\x80\nfloat x;\n";
+	}
+
+	Run("identifier", "main_ps");
+	Run("file name", "shaders/materials/standard_lit.hlsl");
+	Run("ascii source", source);
+	Run("mixed source", mixed);
+	return 0;
+}
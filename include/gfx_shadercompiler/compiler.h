@@ -48,17 +48,111 @@ typedef enum ShaderCompiler_OutputType {
 	ShaderCompiler_OT_MSL_IOS,
 } ShaderCompiler_OutputType;
 
-// both shader and log must be freed by the caller if not null
+// shader and log are MEMORY_MALLOC'd and owner is null unless ShaderCompiler_SetZeroCopyOutputs is on, then
+// shader can be the compilers own buffer handed over without a copy and owner is what keeps it alive.
+// ShaderCompiler_FreeOutput frees either kind
 typedef struct ShaderCompiler_Output {
 	uint64_t shaderSize;
 	void const *shader;
 	char const *log;
+	void *owner;
 } ShaderCompiler_Output;
 
+// value can be null for a define with no value (#define NAME)
+typedef struct ShaderCompiler_Define {
+	char const *name;
+	char const *value;
+} ShaderCompiler_Define;
+
+// one variant of a shader, defines are added after the contexts
+typedef struct ShaderCompiler_Permutation {
+	ShaderCompiler_Define const *defines;
+	uint32_t defineCount;
+} ShaderCompiler_Permutation;
+
+typedef struct ShaderCompiler_Target {
+	ShaderCompiler_OutputType outputType;
+	uint32_t outputVersion; // 0 picks a reasonable default, as ShaderCompiler_SetOutput
+} ShaderCompiler_Target;
+
+typedef struct ShaderCompiler_Job {
+	ShaderCompiler_ShaderType type;
+	char const *name;
+	char const *entryPoint;
+	VFile_Handle file;
+} ShaderCompiler_Job;
+
+typedef struct ShaderCompiler_CacheStats {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t entryCount;
+	uint64_t sizeInBytes;
+	// memory misses that were found in the cache directory (if set)
+	uint64_t diskHits;
+	uint64_t diskMisses;
+} ShaderCompiler_CacheStats;
+
+// DXC allocates through the library so its memory use can be measured
+typedef struct ShaderCompiler_MemoryStats {
+	// held by DXC right now, across every context
+	uint64_t dxcLiveBytes;
+	// the most DXC held at once during a single compile with this context
+	uint64_t dxcPeakCompileBytes;
+} ShaderCompiler_MemoryStats;
+
+// nanoseconds spent in each part of a compile. Parts that run on several threads at once (DXIL and SPIRV
+// front ends, conversion to text targets) are summed so together they can come to more than total.
+// GLSL input (the khronos path) only reports total, readSource and cache
+typedef struct ShaderCompiler_Timings {
+	uint64_t total;
+	uint64_t readSource;
+	// key hashing, lookup (including checking the includes) and storing the result
+	uint64_t cache;
+	// DXC asks for includes as it parses, so this time is also counted in frontEnd
+	uint64_t includes;
+	// DXC, HLSL to DXIL or SPIRV
+	uint64_t frontEnd;
+	// SPIRV-Cross parsing the SPIRV once when it is shared by several text targets
+	uint64_t spirvParse;
+	// SPIRV-Cross, SPIRV to HLSL, GLSL or MSL
+	uint64_t conversion;
+} ShaderCompiler_Timings;
+
+// an output with how it was made, free with ShaderCompiler_FreeOutput(&outputEx.output)
+typedef struct ShaderCompiler_OutputEx {
+	ShaderCompiler_Output output;
+	ShaderCompiler_Timings timings;
+	// the most DXC held at once for this compile, 0 if it came from the cache
+	uint64_t dxcPeakMemory;
+	bool cacheHit;
+	// an identical compile was already running, this waited for it and shares its result
+	bool coalesced;
+	// non zero if this is a tiered compile's unoptimised result, the optimised one is passed to the
+	// tiered callback with the same id
+	uint64_t tieredId;
+} ShaderCompiler_OutputEx;
+
 // when called fill out with a default allocated utf8 string for this filename, the memory will be be owned by
-// shader compiler and it may cache it, true if successful
+// shader compiler and it may cache it, true if successful.
+// may be called from several threads at once (e.g. multi target compiles with DXIL and SPIRV outputs)
 typedef bool (*ShaderCompiler_IncludeCallback)(char const * filename, char ** out);
 
+// an include supplied by an include loader. The memory isn't copied, it must stay valid until release
+// is called with owner (release can be null if the memory outlives the context)
+typedef struct ShaderCompiler_IncludeData {
+	void const *data;
+	size_t size;
+	void (*release)(void *owner);
+	void *owner;
+} ShaderCompiler_IncludeData;
+
+// alternative to the include callback for memory the caller owns (mapped files, asset system buffers...).
+// fill out and return true if filename was found. Same threading rules as the include callback
+typedef bool (*ShaderCompiler_IncludeLoader)(void *userData, char const *filename, ShaderCompiler_IncludeData *out);
+
+// frees the shader and log of an output and clears it, safe on an empty or already freed output
+AL2O3_EXTERN_C void ShaderCompiler_FreeOutput(ShaderCompiler_Output *output);
+
 // stand alone compile function for simple one offs compile
 AL2O3_EXTERN_C bool ShaderCompiler_CompileShader(
 		ShaderCompiler_Language language,
@@ -79,6 +173,11 @@ typedef struct ShaderCompiler_Context *ShaderCompiler_ContextHandle;
 AL2O3_EXTERN_C ShaderCompiler_ContextHandle ShaderCompiler_Create();
 AL2O3_EXTERN_C void ShaderCompiler_Destroy(ShaderCompiler_ContextHandle handle);
 
+// off by default, outputs are plain allocations callers that MEMORY_FREE shader and log directly can keep doing so.
+// On, compiled and cached shaders are handed over without a copy and outputs must be freed with
+// ShaderCompiler_FreeOutput. Must not be changed while compiles are running
+AL2O3_EXTERN_C void ShaderCompiler_SetZeroCopyOutputs(ShaderCompiler_ContextHandle handle, bool zeroCopy);
+
 AL2O3_EXTERN_C void ShaderCompiler_SetLanguage(ShaderCompiler_ContextHandle handle, ShaderCompiler_Language language);
 
 // set the outputVersion to 0 to let the compiler pick a reasonable value (SM6_0)
@@ -92,6 +191,31 @@ AL2O3_EXTERN_C void ShaderCompiler_SetOptimizationLevel(ShaderCompiler_ContextHa
 
 AL2O3_EXTERN_C void ShaderCompiler_AddHeaderCallback(ShaderCompiler_ContextHandle handle, ShaderCompiler_IncludeCallback callback);
 
+// used in preference to the include callback, null to remove. Changing it invalidates all includes.
+// includes stay loaded until invalidated or the context is destroyed, release is called then
+AL2O3_EXTERN_C void ShaderCompiler_SetIncludeLoader(ShaderCompiler_ContextHandle handle,
+																										ShaderCompiler_IncludeLoader loader,
+																										void *userData);
+
+// includes from the loader or callback are loaded once per context and reused by every compile after,
+// ones it couldn't find are remembered as missing the same way. When such a header changes (or appears)
+// invalidate it (by the name used in the #include) so the next compile reloads it.
+// includes read from disk are kept too but every compile checks the file's size and write time, so an
+// edited, new or deleted header is picked up without invalidating.
+// changing the include callback invalidates all includes
+AL2O3_EXTERN_C void ShaderCompiler_InvalidateInclude(ShaderCompiler_ContextHandle handle, char const *name);
+AL2O3_EXTERN_C void ShaderCompiler_InvalidateAllIncludes(ShaderCompiler_ContextHandle handle);
+
+// defines applied to every compile with this context, replaces any previous set. Strings are copied.
+// Define sets are interned per context and converted once, reusing a set (here or per compile) is cheap.
+// Sets no longer in use are released as more are added or when the cache is cleared
+AL2O3_EXTERN_C void ShaderCompiler_SetDefines(ShaderCompiler_ContextHandle handle,
+																							ShaderCompiler_Define const *defines,
+																							uint32_t defineCount);
+
+// a compile identical to one already running on another thread (same settings, source, defines and
+// includes) waits for that one and gets its result rather than compiling again, the shader memory is
+// shared between them and freed when the last output is
 AL2O3_EXTERN_C bool ShaderCompiler_Compile(
 		ShaderCompiler_ContextHandle handle,
 		ShaderCompiler_ShaderType type,
@@ -100,3 +224,168 @@ AL2O3_EXTERN_C bool ShaderCompiler_Compile(
 		VFile_Handle file,
 		ShaderCompiler_Output *output
 );
+
+// as ShaderCompiler_Compile with extra defines for this compile only (after the contexts defines)
+AL2O3_EXTERN_C bool ShaderCompiler_CompileWithDefines(
+		ShaderCompiler_ContextHandle handle,
+		ShaderCompiler_ShaderType type,
+		char const *name,
+		char const *entryPoint,
+		VFile_Handle file,
+		ShaderCompiler_Define const *defines,
+		uint32_t defineCount,
+		ShaderCompiler_Output *output
+);
+
+// as ShaderCompiler_CompileWithDefines (defines can be null) also reporting where the time went
+AL2O3_EXTERN_C bool ShaderCompiler_CompileEx(
+		ShaderCompiler_ContextHandle handle,
+		ShaderCompiler_ShaderType type,
+		char const *name,
+		char const *entryPoint,
+		VFile_Handle file,
+		ShaderCompiler_Define const *defines,
+		uint32_t defineCount,
+		ShaderCompiler_OutputEx *output
+);
+
+// compiles one HLSL source to several outputs sharing a single front end pass, so asking for
+// SPIRV + MSL + GLSL costs one HLSL compile not three. outputs must have targetCount entries
+// and are returned in the same order as targets. Uses the contexts optimization level.
+// DXIL and HLSL targets are compiled with the shader model of their own version, the other targets
+// use the first DXIL targets (or failing that the first HLSL targets). Each different shader model
+// costs a front end pass of its own.
+// Each target is cached, shared with an identical compile already running and captured like a single
+// compile of it would be. Multi target compiles are never tiered and have no timings.
+// returns true only if every target succeeded, each output can still be checked individually
+AL2O3_EXTERN_C bool ShaderCompiler_CompileMulti(
+		ShaderCompiler_ContextHandle handle,
+		ShaderCompiler_ShaderType type,
+		char const *name,
+		char const *entryPoint,
+		VFile_Handle file,
+		ShaderCompiler_Target const *targets,
+		uint32_t targetCount,
+		ShaderCompiler_Output *outputs
+);
+
+// compiles one source once per permutation. Permutations already in the cache are returned from it,
+// the others are preprocessed first and those whose preprocessed source is identical (typically
+// because the shader never tests a define that differs) share a single full compile and its output
+// (each is still freed with ShaderCompiler_FreeOutput).
+// Deduplication is for HLSL input, other languages compile every permutation.
+// outputs must have permutationCount entries, succeeded can be null or have permutationCount entries.
+// returns the number of permutations that succeeded
+AL2O3_EXTERN_C uint32_t ShaderCompiler_CompilePermutations(
+		ShaderCompiler_ContextHandle handle,
+		ShaderCompiler_ShaderType type,
+		char const *name,
+		char const *entryPoint,
+		VFile_Handle file,
+		ShaderCompiler_Permutation const *permutations,
+		uint32_t permutationCount,
+		ShaderCompiler_Output *outputs,
+		bool *succeeded
+);
+
+// compiles jobCount jobs spread over threadCount worker threads (0 = one per hardware thread)
+// using the contexts current settings, which must not be changed until it returns.
+// 0 (or one per hardware thread) reuses threads the context keeps, other counts start and join threads each call.
+// outputs must have jobCount entries, succeeded can be null or have jobCount entries
+// and receives what ShaderCompiler_Compile would have returned for each job.
+// returns the number of jobs that succeeded
+AL2O3_EXTERN_C uint32_t ShaderCompiler_CompileBatch(
+		ShaderCompiler_ContextHandle handle,
+		ShaderCompiler_Job const *jobs,
+		uint32_t jobCount,
+		ShaderCompiler_Output *outputs,
+		bool *succeeded,
+		uint32_t threadCount
+);
+
+typedef struct ShaderCompiler_Ticket *ShaderCompiler_TicketHandle;
+// called on a worker thread once the compile is complete, the result is collected with ShaderCompiler_FinishAsync
+typedef void (*ShaderCompiler_CompletionCallback)(ShaderCompiler_TicketHandle ticket, void *userData);
+
+// number of worker threads used for async compiles, 0 (the default) is one per hardware thread.
+// waits for any outstanding async compiles
+AL2O3_EXTERN_C void ShaderCompiler_SetAsyncThreadCount(ShaderCompiler_ContextHandle handle, uint32_t threadCount);
+
+// queues a compile on the contexts worker threads and returns immediately. name and entryPoint are
+// copied, file must stay valid until the compile is complete. The contexts settings must not be changed
+// while async compiles are outstanding. callback can be null. Every ticket must be passed to
+// ShaderCompiler_FinishAsync once
+AL2O3_EXTERN_C ShaderCompiler_TicketHandle ShaderCompiler_CompileAsync(
+		ShaderCompiler_ContextHandle handle,
+		ShaderCompiler_ShaderType type,
+		char const *name,
+		char const *entryPoint,
+		VFile_Handle file,
+		ShaderCompiler_CompletionCallback callback,
+		void *userData
+);
+
+AL2O3_EXTERN_C bool ShaderCompiler_IsComplete(ShaderCompiler_TicketHandle ticket);
+AL2O3_EXTERN_C void ShaderCompiler_Wait(ShaderCompiler_TicketHandle ticket);
+// blocks until at least one ticket is complete and returns its index, tickets can be from different contexts.
+// null tickets are skipped, returns ~0u if there are no tickets that aren't null
+AL2O3_EXTERN_C uint32_t ShaderCompiler_WaitAny(ShaderCompiler_TicketHandle const *tickets, uint32_t ticketCount);
+// waits if required, hands the output to the caller (or frees it if output is null) and releases
+// the ticket. returns what ShaderCompiler_Compile would have
+AL2O3_EXTERN_C bool ShaderCompiler_FinishAsync(ShaderCompiler_TicketHandle ticket, ShaderCompiler_Output *output);
+
+// called on an async worker thread when the optimised compile of a tiered compile is done. id matches
+// ShaderCompiler_OutputEx::tieredId, output belongs to the callee (free with ShaderCompiler_FreeOutput)
+typedef void (*ShaderCompiler_TieredCallback)(void *userData,
+																							uint64_t id,
+																							char const *name,
+																							char const *entryPoint,
+																							bool succeeded,
+																							ShaderCompiler_Output *output);
+
+// tiered compiles for fast iteration. With a callback set, compiles (ShaderCompiler_Compile, WithDefines, Ex
+// and Async) of HLSL return an unoptimised (OPT_None) result and queue a compile at the contexts optimisation
+// level on the async worker threads which is passed to callback when done, with the settings the compile was
+// made with even if they are changed before it runs. If the optimised result is already
+// cached it is returned straight away with no second compile. If the unoptimised compile fails with an error
+// log nothing is queued and tieredId stays 0. Nothing is tiered if the optimisation level is
+// OPT_None. null turns it off, queued optimised compiles still call the callback they were queued with.
+// Must not be changed while compiles are running
+AL2O3_EXTERN_C void ShaderCompiler_SetTieredCallback(ShaderCompiler_ContextHandle handle,
+																										 ShaderCompiler_TieredCallback callback,
+																										 void *userData);
+
+// each context keeps an in memory cache of compile results keyed on a hash of the source,
+// the includes it used, the entry point, shader type and all the compile settings.
+// compiles that fail with an error log are cached too, so a broken shader returns false and the same log
+// without recompiling until it or an include changes.
+// budget is in bytes, 0 disables the cache. Defaults to 64 MiB
+AL2O3_EXTERN_C void ShaderCompiler_SetCacheBudget(ShaderCompiler_ContextHandle handle, uint64_t budget);
+AL2O3_EXTERN_C void ShaderCompiler_ClearCache(ShaderCompiler_ContextHandle handle);
+AL2O3_EXTERN_C void ShaderCompiler_GetCacheStats(ShaderCompiler_ContextHandle handle, ShaderCompiler_CacheStats *stats);
+
+AL2O3_EXTERN_C void ShaderCompiler_GetMemoryStats(ShaderCompiler_ContextHandle handle, ShaderCompiler_MemoryStats *stats);
+// starts dxcPeakCompileBytes again from 0
+AL2O3_EXTERN_C void ShaderCompiler_ResetMemoryStats(ShaderCompiler_ContextHandle handle);
+
+// records what every compile with this context does and when, per shader and per phase (source read,
+// cache, include loads, waiting for a DXC instance, DXC, SPIRV-Cross, output) with the thread it ran on.
+// off by default, turning it on starts a new recording. Must not be changed while compiles are running
+AL2O3_EXTERN_C void ShaderCompiler_SetTracing(ShaderCompiler_ContextHandle handle, bool enabled);
+// writes the recording as Chrome trace event JSON (chrome://tracing or ui.perfetto.dev),
+// false if tracing is off or the file couldn't be written
+AL2O3_EXTERN_C bool ShaderCompiler_WriteTrace(ShaderCompiler_ContextHandle handle, char const *path);
+
+// records every compile with this context (settings, defines, source and the contents of each include it
+// loads) to path, for replaying elsewhere with the capture_replay benchmark tool. A compile is written when
+// it finishes. null stops recording. Starting a capture empties the include cache so every include is
+// recorded. Must not be changed while compiles are running, false if the file couldn't be created
+AL2O3_EXTERN_C bool ShaderCompiler_SetCaptureFile(ShaderCompiler_ContextHandle handle, char const *path);
+
+// optional persistent cache shared between processes, behind the in memory one. Results are only
+// returned to the same dxcompiler and SPIRV-Cross versions that made them.
+// directory is created if needed, null disables. returns false if it couldn't be opened
+AL2O3_EXTERN_C bool ShaderCompiler_SetCacheDirectory(ShaderCompiler_ContextHandle handle, char const *directory);
+// most bytes of results kept in the cache directory, the least recently used are deleted to stay under it.
+// 0 is no limit. Defaults to 1 GiB
+AL2O3_EXTERN_C void ShaderCompiler_SetCacheDirectoryBudget(ShaderCompiler_ContextHandle handle, uint64_t budget);
@@ -24,14 +24,23 @@
  */
 
 #include "al2o3_platform/platform.h"
+#include "al2o3_memory/memory.h"
 #include <ShaderConductor/ShaderConductor.hpp>
+#include "arena.hpp"
+#include "timing.hpp"
 
 
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <cstddef>
+#include <exception>
 #include <fstream>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <dxc/Support/Global.h>
 #include <dxc/Support/Unicode.h>
@@ -46,15 +55,243 @@
 #include <spirv_glsl.hpp>
 #include <spirv_hlsl.hpp>
 #include <spirv_msl.hpp>
+#include <spirv_parser.hpp>
+#if __has_include(<spirv_cross_c.h>)
+#include <spirv_cross_c.h>
+#endif
 
 #define SC_UNUSED(x) (void)(x);
 
 using namespace ShaderConductor;
 
+namespace ShaderConductor
+{
+class DefineSet
+{
+public:
+	DefineSet(const MacroDefine* defines, uint32_t numDefines)
+	{
+		// Need to reserve capacity so that small-string optimization does not
+		// invalidate the pointers to internal string data while resizing.
+		m_dxcDefineStrings.reserve(numDefines * 2);
+		m_dxcDefines.reserve(numDefines);
+		for (size_t i = 0; i < numDefines; ++i)
+		{
+			const auto& define = defines[i];
+
+			std::wstring nameUtf16Str;
+			Unicode::UTF8ToUTF16String(define.name, &nameUtf16Str);
+			m_dxcDefineStrings.emplace_back(std::move(nameUtf16Str));
+			const wchar_t* nameUtf16 = m_dxcDefineStrings.back().c_str();
+
+			const wchar_t* valueUtf16;
+			if (define.value != nullptr)
+			{
+				std::wstring valueUtf16Str;
+				Unicode::UTF8ToUTF16String(define.value, &valueUtf16Str);
+				m_dxcDefineStrings.emplace_back(std::move(valueUtf16Str));
+				valueUtf16 = m_dxcDefineStrings.back().c_str();
+			}
+			else
+			{
+				valueUtf16 = nullptr;
+			}
+
+			m_dxcDefines.push_back({ nameUtf16, valueUtf16 });
+		}
+	}
+
+	DefineSet(const DefineSet&) = delete;
+	DefineSet& operator=(const DefineSet&) = delete;
+
+	const DxcDefine* Defines() const
+	{
+		return m_dxcDefines.data();
+	}
+
+	UINT32 NumDefines() const
+	{
+		return static_cast<UINT32>(m_dxcDefines.size());
+	}
+
+private:
+	std::vector<std::wstring> m_dxcDefineStrings;
+	std::vector<DxcDefine> m_dxcDefines;
+};
+
+class ArgumentCache
+{
+public:
+	// Everything a front end pass passes to DXC that only depends on the options, stage and target
+	struct Arguments
+	{
+		std::wstring profile;
+		std::vector<std::wstring> strings;
+		std::vector<LPCWSTR> pointers;
+	};
+
+	const Arguments& Get(const Compiler::Options& options, ShaderStage stage, ShadingLanguage targetLanguage);
+
+private:
+	std::mutex m_mutex;
+	std::unordered_map<uint32_t, std::unique_ptr<Arguments>> m_arguments;
+};
+} // namespace ShaderConductor
+
 namespace
 {
 bool dllDetaching = false;
 
+// Every allocation DXC makes goes through this, the objects are created with it (DxcCreateInstance2).
+// Memory comes from al2o3_memory with the size in a header, so bytes held are counted in total and per
+// thread. A front end pass runs on one thread, so the thread's high water mark since BeginTracking is
+// the most DXC needed for that compile. Frees on another thread (a result released later) just lower
+// that threads count, which is why the thread counts are signed
+class DxcMalloc : public IMalloc
+{
+public:
+	// Never destroyed, blobs DXC made with it can be released at any time
+	static DxcMalloc& Instance()
+	{
+		static DxcMalloc* instance = new DxcMalloc();
+		return *instance;
+	}
+
+	static void BeginTracking()
+	{
+		t_baseline = t_live;
+		t_peak = t_live;
+	}
+
+	static uint64_t TrackedPeak()
+	{
+		return static_cast<uint64_t>(t_peak - t_baseline);
+	}
+
+	static uint64_t LiveBytes()
+	{
+		return s_live.load(std::memory_order_relaxed);
+	}
+
+	void* STDMETHODCALLTYPE Alloc(SIZE_T size) override
+	{
+		Header* header = static_cast<Header*>(MEMORY_MALLOC(sizeof(Header) + size));
+		if (header == nullptr)
+		{
+			return nullptr;
+		}
+		header->size = size;
+		Track(static_cast<int64_t>(size));
+		return header + 1;
+	}
+
+	void* STDMETHODCALLTYPE Realloc(void* ptr, SIZE_T size) override
+	{
+		if (ptr == nullptr)
+		{
+			return this->Alloc(size);
+		}
+		if (size == 0)
+		{
+			this->Free(ptr);
+			return nullptr;
+		}
+
+		Header* header = static_cast<Header*>(ptr) - 1;
+		const size_t oldSize = header->size;
+		header = static_cast<Header*>(MEMORY_REALLOC(header, sizeof(Header) + size));
+		if (header == nullptr)
+		{
+			return nullptr;
+		}
+		header->size = size;
+		Track(static_cast<int64_t>(size) - static_cast<int64_t>(oldSize));
+		return header + 1;
+	}
+
+	void STDMETHODCALLTYPE Free(void* ptr) override
+	{
+		if (ptr == nullptr)
+		{
+			return;
+		}
+		Header* header = static_cast<Header*>(ptr) - 1;
+		Track(-static_cast<int64_t>(header->size));
+		MEMORY_FREE(header);
+	}
+
+#ifdef _WIN32
+	SIZE_T STDMETHODCALLTYPE GetSize(void* ptr) override
+	{
+		return (ptr != nullptr) ? (static_cast<Header*>(ptr) - 1)->size : static_cast<SIZE_T>(-1);
+	}
+
+	int STDMETHODCALLTYPE DidAlloc(void* ptr) override
+	{
+		SC_UNUSED(ptr);
+		return -1;
+	}
+
+	void STDMETHODCALLTYPE HeapMinimize() override
+	{
+	}
+#endif
+
+	ULONG STDMETHODCALLTYPE AddRef() override
+	{
+		return 1;
+	}
+
+	ULONG STDMETHODCALLTYPE Release() override
+	{
+		return 1;
+	}
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void** object) override
+	{
+		if (IsEqualIID(iid, __uuidof(IMalloc)) || IsEqualIID(iid, __uuidof(IUnknown)))
+		{
+			*object = this;
+			return S_OK;
+		}
+		*object = nullptr;
+		return E_NOINTERFACE;
+	}
+
+private:
+	struct alignas(std::max_align_t) Header
+	{
+		size_t size;
+	};
+
+	static void Track(int64_t delta)
+	{
+		s_live.fetch_add(static_cast<uint64_t>(delta), std::memory_order_relaxed);
+		t_live += delta;
+		if (t_live > t_peak)
+		{
+			t_peak = t_live;
+		}
+	}
+
+	static std::atomic<uint64_t> s_live;
+	static thread_local int64_t t_live;
+	static thread_local int64_t t_peak;
+	static thread_local int64_t t_baseline;
+};
+
+std::atomic<uint64_t> DxcMalloc::s_live{ 0 };
+thread_local int64_t DxcMalloc::t_live = 0;
+thread_local int64_t DxcMalloc::t_peak = 0;
+thread_local int64_t DxcMalloc::t_baseline = 0;
+
+// A library/compiler pair, only ever used by one compile at a time
+struct DxcObjects
+{
+	CComPtr<IDxcLibrary> library;
+	CComPtr<IDxcCompiler> compiler;
+};
+
 class Dxcompiler
 {
 public:
@@ -69,24 +306,42 @@ public:
 		return instance;
 	}
 
-	IDxcLibrary* Library() const
+	// Checks out a pair for exclusive use, reusing an idle one when possible. The pool grows to the
+	// peak number of concurrent compiles, so threads never share a compiler or wait on each other
+	std::unique_ptr<DxcObjects> Acquire()
 	{
-		return m_library;
+		{
+			std::lock_guard<std::mutex> lock(m_poolMutex);
+			if (!m_idle.empty())
+			{
+				std::unique_ptr<DxcObjects> objects = std::move(m_idle.back());
+				m_idle.pop_back();
+				return objects;
+			}
+		}
+		return this->CreateObjects();
 	}
 
-	IDxcCompiler* Compiler() const
+	void Release(std::unique_ptr<DxcObjects> objects)
 	{
-		return m_compiler;
+		if (objects)
+		{
+			std::lock_guard<std::mutex> lock(m_poolMutex);
+			m_idle.push_back(std::move(objects));
+		}
 	}
 
 	void Destroy()
 	{
 		if (m_dxcompilerDll)
 		{
-			m_compiler = nullptr;
-			m_library = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(m_poolMutex);
+				m_idle.clear();
+			}
 
 			m_createInstanceFunc = nullptr;
+			m_createInstance2Func = nullptr;
 
 #ifdef _WIN32
 			::FreeLibrary(m_dxcompilerDll);
@@ -102,10 +357,18 @@ public:
 	{
 		if (m_dxcompilerDll)
 		{
-			m_compiler.Detach();
-			m_library.Detach();
+			{
+				std::lock_guard<std::mutex> lock(m_poolMutex);
+				for (auto& objects : m_idle)
+				{
+					objects->compiler.Detach();
+					objects->library.Detach();
+				}
+				m_idle.clear();
+			}
 
 			m_createInstanceFunc = nullptr;
+			m_createInstance2Func = nullptr;
 
 			m_dxcompilerDll = nullptr;
 		}
@@ -137,21 +400,15 @@ private:
 		{
 #ifdef _WIN32
 			m_createInstanceFunc = (DxcCreateInstanceProc)::GetProcAddress(m_dxcompilerDll, functionName);
+			m_createInstance2Func = (DxcCreateInstance2Proc)::GetProcAddress(m_dxcompilerDll, "DxcCreateInstance2");
 #else
 			m_createInstanceFunc = (DxcCreateInstanceProc)::dlsym(m_dxcompilerDll, functionName);
 #endif
 
 			if (m_createInstanceFunc != nullptr)
 			{
-				// for some as yet unknown reason the dylib function DxcCreateInstance doesn't work if not linked
-				// implicitly... so for now this hack appears to work
-#ifdef _WIN32
-				IFT(m_createInstanceFunc(CLSID_DxcLibrary, __uuidof(IDxcLibrary), reinterpret_cast<void**>(&m_library)));
-				IFT(m_createInstanceFunc(CLSID_DxcCompiler, __uuidof(IDxcCompiler), reinterpret_cast<void**>(&m_compiler)));
-#else
-				IFT( DxcCreateInstance(CLSID_DxcLibrary, __uuidof(IDxcLibrary), reinterpret_cast<void**>(&m_library)));
-				IFT( DxcCreateInstance(CLSID_DxcCompiler, __uuidof(IDxcCompiler), reinterpret_cast<void**>(&m_compiler)));
-#endif
+				// create the first pair up front so a broken dll is reported here
+				m_idle.push_back(this->CreateObjects());
 			}
 			else
 			{
@@ -166,18 +423,82 @@ private:
 		}
 	}
 
+	std::unique_ptr<DxcObjects> CreateObjects() const
+	{
+		auto objects = std::make_unique<DxcObjects>();
+		IMalloc* malloc = &DxcMalloc::Instance();
+		// for some as yet unknown reason the dylib function DxcCreateInstance doesn't work if not linked
+		// implicitly... so for now this hack appears to work
+#ifdef _WIN32
+		if (m_createInstance2Func != nullptr)
+		{
+			IFT(m_createInstance2Func(malloc, CLSID_DxcLibrary, __uuidof(IDxcLibrary), reinterpret_cast<void**>(&objects->library)));
+			IFT(m_createInstance2Func(malloc, CLSID_DxcCompiler, __uuidof(IDxcCompiler),
+																reinterpret_cast<void**>(&objects->compiler)));
+		}
+		else
+		{
+			// an old dll without the IMalloc entry point, its memory isn't tracked
+			IFT(m_createInstanceFunc(CLSID_DxcLibrary, __uuidof(IDxcLibrary), reinterpret_cast<void**>(&objects->library)));
+			IFT(m_createInstanceFunc(CLSID_DxcCompiler, __uuidof(IDxcCompiler), reinterpret_cast<void**>(&objects->compiler)));
+		}
+#else
+		IFT( DxcCreateInstance2(malloc, CLSID_DxcLibrary, __uuidof(IDxcLibrary), reinterpret_cast<void**>(&objects->library)));
+		IFT( DxcCreateInstance2(malloc, CLSID_DxcCompiler, __uuidof(IDxcCompiler), reinterpret_cast<void**>(&objects->compiler)));
+#endif
+		return objects;
+	}
+
 private:
 	HMODULE m_dxcompilerDll = nullptr;
 	DxcCreateInstanceProc m_createInstanceFunc = nullptr;
+	DxcCreateInstance2Proc m_createInstance2Func = nullptr;
 
-	CComPtr<IDxcLibrary> m_library;
-	CComPtr<IDxcCompiler> m_compiler;
+	std::mutex m_poolMutex;
+	std::vector<std::unique_ptr<DxcObjects>> m_idle;
+};
+
+// Holds a checked out DxcObjects for the duration of a scope
+class ScopedDxcObjects
+{
+public:
+	ScopedDxcObjects() : m_objects(Dxcompiler::Instance().Acquire())
+	{
+	}
+
+	// Reports the wait for a free pair (or making one) to the source's phase callback
+	explicit ScopedDxcObjects(const Compiler::SourceDesc& source)
+	{
+		const uint64_t begin = source.phaseCallback ? ShaderCompiler::NowNs() : 0;
+		m_objects = Dxcompiler::Instance().Acquire();
+		if (source.phaseCallback)
+		{
+			source.phaseCallback(Compiler::Phase::AcquireCompiler, begin, ShaderCompiler::NowNs());
+		}
+	}
+
+	~ScopedDxcObjects()
+	{
+		Dxcompiler::Instance().Release(std::move(m_objects));
+	}
+
+	ScopedDxcObjects(const ScopedDxcObjects&) = delete;
+	ScopedDxcObjects& operator=(const ScopedDxcObjects&) = delete;
+
+	const DxcObjects& Get() const
+	{
+		return *m_objects;
+	}
+
+private:
+	std::unique_ptr<DxcObjects> m_objects;
 };
 
 class ScIncludeHandler : public IDxcIncludeHandler
 {
 public:
-	explicit ScIncludeHandler(std::function<Blob*(const char* includeName)> loadCallback) : m_loadCallback(std::move(loadCallback))
+	ScIncludeHandler(std::function<Blob*(const char* includeName)> loadCallback, IDxcLibrary* library)
+		: m_loadCallback(std::move(loadCallback)), m_library(library)
 	{
 	}
 
@@ -188,8 +509,10 @@ public:
 			fileName += 2;
 		}
 
-		std::string utf8FileName;
-		if (!Unicode::UTF16ToUTF8String(fileName, &utf8FileName))
+		// The name is only needed for the callback
+		ShaderCompiler::ArenaScope scratch;
+		const char* utf8FileName = ShaderCompiler::ArenaWideToUtf8(scratch.Get(), fileName);
+		if (utf8FileName == nullptr)
 		{
 			return E_FAIL;
 		}
@@ -199,7 +522,7 @@ public:
 		std::unique_ptr<Blob, decltype(blobDeleter)> source(nullptr, blobDeleter);
 		try
 		{
-			source.reset(m_loadCallback(utf8FileName.c_str()));
+			source.reset(m_loadCallback(utf8FileName));
 		}
 		catch (...)
 		{
@@ -207,8 +530,19 @@ public:
 		}
 
 		*includeSource = nullptr;
-		return Dxcompiler::Instance().Library()->CreateBlobWithEncodingOnHeapCopy(
+		if (!source)
+		{
+			return E_FAIL;
+		}
+
+		// DXC reads the include in place, the blob is kept until the handler goes away at the end of the compile
+		HRESULT hr = m_library->CreateBlobWithEncodingFromPinned(
 				source->Data(), source->Size(), CP_UTF8, reinterpret_cast<IDxcBlobEncoding**>(includeSource));
+		if (SUCCEEDED(hr))
+		{
+			m_loaded.emplace_back(source.release());
+		}
+		return hr;
 	}
 
 	ULONG STDMETHODCALLTYPE AddRef() override
@@ -249,55 +583,187 @@ public:
 	}
 
 private:
+	struct BlobDeleter
+	{
+		void operator()(Blob* blob) const
+		{
+			DestroyBlob(blob);
+		}
+	};
+
 	std::function<Blob*(const char* includeName)> m_loadCallback;
+	IDxcLibrary* m_library;
+	std::vector<std::unique_ptr<Blob, BlobDeleter>> m_loaded;
 
 	std::atomic<ULONG> m_ref = 0;
 };
 
-Blob* DefaultLoadCallback(const char* includeName)
+// Always followed by a 0 that isn't part of the size, so text can be used as a C string
+class ScBlob : public Blob
 {
-	std::vector<char> ret;
-	std::ifstream includeFile(includeName, std::ios_base::in);
-	if (includeFile)
+public:
+	ScBlob(const void* data, uint32_t size) : data_(size + 1)
 	{
-		includeFile.seekg(0, std::ios::end);
-		ret.resize(static_cast<size_t>(includeFile.tellg()));
-		includeFile.seekg(0, std::ios::beg);
-		includeFile.read(ret.data(), ret.size());
-		ret.resize(static_cast<size_t>(includeFile.gcount()));
+		memcpy(data_.data(), data, size);
+		data_[size] = 0;
 	}
-	else
+
+	const void* Data() const override
 	{
-		throw std::runtime_error(std::string("COULDN'T load included file ") + includeName + ".");
+		return data_.data();
 	}
-	return CreateBlob(ret.data(), static_cast<uint32_t>(ret.size()));
-}
 
-class ScBlob : public Blob
+	uint32_t Size() const override
+	{
+		return static_cast<uint32_t>(data_.size() - 1);
+	}
+
+private:
+	std::vector<uint8_t> data_;
+};
+
+// Takes over a DXC result, the bytecode stays in the buffer DXC made
+class DxcResultBlob : public Blob
 {
 public:
-	ScBlob(const void* data, uint32_t size)
-			: data_(reinterpret_cast<const uint8_t*>(data), reinterpret_cast<const uint8_t*>(data) + size)
+	explicit DxcResultBlob(CComPtr<IDxcBlob> blob) : blob_(std::move(blob))
 	{
 	}
 
 	const void* Data() const override
 	{
-		return data_.data();
+		return blob_->GetBufferPointer();
 	}
 
 	uint32_t Size() const override
 	{
-		return static_cast<uint32_t>(data_.size());
+		return static_cast<uint32_t>(blob_->GetBufferSize());
 	}
 
 private:
-	std::vector<uint8_t> data_;
+	CComPtr<IDxcBlob> blob_;
+};
+
+// Takes over a string, e.g. SPIRV-Cross output. std::string is 0 terminated like ScBlob
+class StringBlob : public Blob
+{
+public:
+	explicit StringBlob(std::string str) : str_(std::move(str))
+	{
+	}
+
+	const void* Data() const override
+	{
+		return str_.data();
+	}
+
+	uint32_t Size() const override
+	{
+		return static_cast<uint32_t>(str_.size());
+	}
+
+private:
+	std::string str_;
+};
+
+// A reference to a blob that several results share
+class SharedBlob : public Blob
+{
+public:
+	explicit SharedBlob(std::shared_ptr<Blob> blob) : blob_(std::move(blob))
+	{
+	}
+
+	const void* Data() const override
+	{
+		return blob_->Data();
+	}
+
+	uint32_t Size() const override
+	{
+		return blob_->Size();
+	}
+
+private:
+	std::shared_ptr<Blob> blob_;
+};
+
+// Hands a front end blob to the targets that use it without copying it. With a single target the blob
+// itself is taken, with several each gets a SharedBlob and the blob goes when the last of them does
+class BlobShare
+{
+public:
+	BlobShare(Blob* blob, bool shared) : m_blob(blob)
+	{
+		if (shared && (blob != nullptr))
+		{
+			m_shared = std::shared_ptr<Blob>(blob, DestroyBlob);
+		}
+	}
+
+	~BlobShare()
+	{
+		if (!m_shared)
+		{
+			DestroyBlob(m_blob);
+		}
+	}
+
+	BlobShare(const BlobShare&) = delete;
+	BlobShare& operator=(const BlobShare&) = delete;
+
+	// Read only access, valid until this is destroyed
+	Blob* Get() const
+	{
+		return m_blob;
+	}
+
+	Blob* Take()
+	{
+		if (m_shared)
+		{
+			return new SharedBlob(m_shared);
+		}
+		Blob* blob = m_blob;
+		m_blob = nullptr;
+		return blob;
+	}
+
+private:
+	Blob* m_blob;
+	std::shared_ptr<Blob> m_shared;
 };
 
-void AppendError(Compiler::ResultDesc& result, const std::string& msg)
+// Destroys a result's blobs along with it
+struct ResultDeleter
 {
-	std::string errorMSg;
+	void operator()(Compiler::ResultDesc* result) const
+	{
+		DestroyBlob(result->target);
+		DestroyBlob(result->errorWarningMsg);
+		delete result;
+	}
+};
+
+// A result that hasn't been handed to the caller yet, if anything throws first its blobs are destroyed
+using ResultPtr = std::unique_ptr<Compiler::ResultDesc, ResultDeleter>;
+
+ResultPtr OwnResult(const Compiler::ResultDesc& result)
+{
+	return ResultPtr(new Compiler::ResultDesc(result));
+}
+
+// Hands the blobs to the caller, owner is left empty
+void ReleaseResult(ResultPtr& owner, Compiler::ResultDesc& out)
+{
+	out = *owner;
+	delete owner.release();
+}
+
+void AppendError(Compiler::ResultDesc& result, const char* msg)
+{
+	ShaderCompiler::ArenaScope scratch;
+	ShaderCompiler::ArenaString errorMSg{ ShaderCompiler::ArenaAllocator<char>(scratch.Get()) };
 	if (result.errorWarningMsg != nullptr)
 	{
 		errorMSg.assign(reinterpret_cast<const char*>(result.errorWarningMsg->Data()), result.errorWarningMsg->Size());
@@ -312,13 +778,10 @@ void AppendError(Compiler::ResultDesc& result, const std::string& msg)
 	result.hasError = true;
 }
 
-Compiler::ResultDesc CompileToBinary(const Compiler::SourceDesc& source, const Compiler::Options& options,
-																		 ShadingLanguage targetLanguage)
+std::wstring ShaderProfile(ShaderStage stage, const Compiler::Options& options)
 {
-	assert((targetLanguage == ShadingLanguage::Dxil) || (targetLanguage == ShadingLanguage::SpirV));
-
 	std::wstring shaderProfile;
-	switch (source.stage)
+	switch (stage)
 	{
 	case ShaderStage::VertexShader:
 		shaderProfile = L"vs";
@@ -351,48 +814,13 @@ Compiler::ResultDesc CompileToBinary(const Compiler::SourceDesc& source, const C
 	shaderProfile.push_back(L'0' + options.shaderModel.major_ver);
 	shaderProfile.push_back(L'_');
 	shaderProfile.push_back(L'0' + options.shaderModel.minor_ver);
+	return shaderProfile;
+}
 
-	std::vector<DxcDefine> dxcDefines;
-	std::vector<std::wstring> dxcDefineStrings;
-	// Need to reserve capacity so that small-string optimization does not
-	// invalidate the pointers to internal string data while resizing.
-	dxcDefineStrings.reserve(source.numDefines * 2);
-	for (size_t i = 0; i < source.numDefines; ++i)
-	{
-		const auto& define = source.defines[i];
-
-		std::wstring nameUtf16Str;
-		Unicode::UTF8ToUTF16String(define.name, &nameUtf16Str);
-		dxcDefineStrings.emplace_back(std::move(nameUtf16Str));
-		const wchar_t* nameUtf16 = dxcDefineStrings.back().c_str();
-
-		const wchar_t* valueUtf16;
-		if (define.value != nullptr)
-		{
-			std::wstring valueUtf16Str;
-			Unicode::UTF8ToUTF16String(define.value, &valueUtf16Str);
-			dxcDefineStrings.emplace_back(std::move(valueUtf16Str));
-			valueUtf16 = dxcDefineStrings.back().c_str();
-		}
-		else
-		{
-			valueUtf16 = nullptr;
-		}
-
-		dxcDefines.push_back({ nameUtf16, valueUtf16 });
-	}
-
-	CComPtr<IDxcBlobEncoding> sourceBlob;
-	IFT(Dxcompiler::Instance().Library()->CreateBlobWithEncodingOnHeapCopy(source.source, static_cast<UINT32>(strlen(source.source)),
-																																				 CP_UTF8, &sourceBlob));
-	IFTARG(sourceBlob->GetBufferSize() >= 4);
-
-	std::wstring shaderNameUtf16;
-	Unicode::UTF8ToUTF16String(source.fileName, &shaderNameUtf16);
-
-	std::wstring entryPointUtf16;
-	Unicode::UTF8ToUTF16String(source.entryPoint, &entryPointUtf16);
-
+// The command line arguments for a front end pass, shared by compile and preprocess so both see the
+// same predefined macros
+std::vector<std::wstring> DxcArguments(const Compiler::Options& options, ShadingLanguage targetLanguage)
+{
 	std::vector<std::wstring> dxcArgStrings;
 
 	// HLSL matrices are translated into SPIR-V OpTypeMatrixs in a transposed manner,
@@ -457,18 +885,107 @@ Compiler::ResultDesc CompileToBinary(const Compiler::SourceDesc& source, const C
 		LOGERROR("Invalid shading language.");
 	}
 
+	return dxcArgStrings;
+}
+
+std::vector<const wchar_t*> DxcArgumentPointers(const std::vector<std::wstring>& dxcArgStrings)
+{
 	std::vector<const wchar_t*> dxcArgs;
 	dxcArgs.reserve(dxcArgStrings.size());
 	for (const auto& arg : dxcArgStrings)
 	{
 		dxcArgs.push_back(arg.c_str());
 	}
+	return dxcArgs;
+}
 
-	CComPtr<IDxcIncludeHandler> includeHandler = new ScIncludeHandler(std::move(source.loadIncludeCallback));
+// Tells the source's phase callback (if there is one) how long the scope took
+class ScopedPhase
+{
+public:
+	ScopedPhase(const Compiler::SourceDesc& source, Compiler::Phase phase)
+		: m_source(source), m_phase(phase), m_begin(source.phaseCallback ? ShaderCompiler::NowNs() : 0)
+	{
+	}
+
+	~ScopedPhase()
+	{
+		if (m_source.phaseCallback)
+		{
+			m_source.phaseCallback(m_phase, m_begin, ShaderCompiler::NowNs());
+		}
+	}
+
+	ScopedPhase(const ScopedPhase&) = delete;
+	ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+private:
+	const Compiler::SourceDesc& m_source;
+	const Compiler::Phase m_phase;
+	const uint64_t m_begin;
+};
+
+// Arguments come prebuilt from the cache if there is one, otherwise they are made for this compile and kept in local
+const ArgumentCache::Arguments* FrontEndArguments(const Compiler::Options& options, ShaderStage stage,
+																									ShadingLanguage targetLanguage,
+																									std::unique_ptr<ArgumentCache::Arguments>& local)
+{
+	if (options.argumentCache != nullptr)
+	{
+		return &options.argumentCache->Get(options, stage, targetLanguage);
+	}
+	local = std::make_unique<ArgumentCache::Arguments>();
+	local->profile = ShaderProfile(stage, options);
+	local->strings = DxcArguments(options, targetLanguage);
+	local->pointers = DxcArgumentPointers(local->strings);
+	return local.get();
+}
+
+// Compiles convert names with this, the result lives until the arena scope ends. Names that aren't valid
+// UTF-8 go to DXC empty
+const wchar_t* ScratchUtf16(ShaderCompiler::Arena& arena, const char* utf8)
+{
+	const wchar_t* utf16 = ShaderCompiler::ArenaUtf8ToWide(arena, utf8);
+	return (utf16 != nullptr) ? utf16 : L"";
+}
+
+Compiler::ResultDesc CompileToBinary(const Compiler::SourceDesc& source, const Compiler::Options& options,
+																		 ShadingLanguage targetLanguage, const DxcObjects& dxc)
+{
+	assert((targetLanguage == ShadingLanguage::Dxil) || (targetLanguage == ShadingLanguage::SpirV));
+
+	ScopedPhase phase(source, Compiler::Phase::FrontEnd);
+
+	// Transient allocations for the compile come from here and go when it returns
+	ShaderCompiler::ArenaScope scratch;
+	DxcMalloc::BeginTracking();
+
+	std::unique_ptr<ArgumentCache::Arguments> localArguments;
+	const ArgumentCache::Arguments* arguments = FrontEndArguments(options, source.stage, targetLanguage, localArguments);
+
+	std::unique_ptr<DefineSet> localDefines;
+	const DefineSet* defineSet = source.defineSet;
+	if (defineSet == nullptr)
+	{
+		localDefines = std::make_unique<DefineSet>(source.defines, source.numDefines);
+		defineSet = localDefines.get();
+	}
+
+	// the source outlives the compile so DXC can read it in place
+	CComPtr<IDxcBlobEncoding> sourceBlob;
+	IFT(dxc.library->CreateBlobWithEncodingFromPinned(source.source, static_cast<UINT32>(strlen(source.source)), CP_UTF8,
+																										&sourceBlob));
+	IFTARG(sourceBlob->GetBufferSize() >= 4);
+
+	const wchar_t* shaderNameUtf16 = ScratchUtf16(scratch.Get(), source.fileName);
+	const wchar_t* entryPointUtf16 = ScratchUtf16(scratch.Get(), source.entryPoint);
+
+	CComPtr<IDxcIncludeHandler> includeHandler = new ScIncludeHandler(std::move(source.loadIncludeCallback), dxc.library);
 	CComPtr<IDxcOperationResult> compileResult;
-	IFT(Dxcompiler::Instance().Compiler()->Compile(sourceBlob, shaderNameUtf16.c_str(), entryPointUtf16.c_str(), shaderProfile.c_str(),
-																								 dxcArgs.data(), static_cast<UINT32>(dxcArgs.size()), dxcDefines.data(),
-																								 static_cast<UINT32>(dxcDefines.size()), includeHandler, &compileResult));
+	IFT(dxc.compiler->Compile(sourceBlob, shaderNameUtf16, entryPointUtf16, arguments->profile.c_str(),
+																								 const_cast<LPCWSTR*>(arguments->pointers.data()),
+																								 static_cast<UINT32>(arguments->pointers.size()), defineSet->Defines(),
+																								 defineSet->NumDefines(), includeHandler, &compileResult));
 
 	HRESULT status;
 	IFT(compileResult->GetStatus(&status));
@@ -498,24 +1015,120 @@ Compiler::ResultDesc CompileToBinary(const Compiler::SourceDesc& source, const C
 		compileResult = nullptr;
 		if (program != nullptr)
 		{
-			ret.target = CreateBlob(program->GetBufferPointer(), static_cast<uint32_t>(program->GetBufferSize()));
+			ret.target = new DxcResultBlob(std::move(program));
 			ret.hasError = false;
 		}
 	}
 
+	ret.dxcPeakMemory = DxcMalloc::TrackedPeak();
 	return ret;
 }
 
-Compiler::ResultDesc ConvertBinary(const Compiler::ResultDesc& binaryResult, const Compiler::SourceDesc& source,
-																	 const Compiler::TargetDesc& target)
+// Runs only the preprocessor, the result is the expanded source text. Uses the same arguments and
+// profile as a compile to the target so predefined macros (__spirv__, __SHADER_TARGET_MAJOR etc.) match
+Compiler::ResultDesc PreprocessToText(const Compiler::SourceDesc& source, const Compiler::Options& options,
+																			ShadingLanguage targetLanguage, const DxcObjects& dxc)
+{
+	ScopedPhase phase(source, Compiler::Phase::Preprocess);
+	ShaderCompiler::ArenaScope scratch;
+
+	std::unique_ptr<DefineSet> localDefines;
+	const DefineSet* defineSet = source.defineSet;
+	if (defineSet == nullptr)
+	{
+		localDefines = std::make_unique<DefineSet>(source.defines, source.numDefines);
+		defineSet = localDefines.get();
+	}
+
+	// the source outlives the compile so DXC can read it in place
+	CComPtr<IDxcBlobEncoding> sourceBlob;
+	IFT(dxc.library->CreateBlobWithEncodingFromPinned(source.source, static_cast<UINT32>(strlen(source.source)), CP_UTF8,
+																										&sourceBlob));
+
+	const wchar_t* shaderNameUtf16 = ScratchUtf16(scratch.Get(), source.fileName);
+	const wchar_t* entryPointUtf16 = ScratchUtf16(scratch.Get(), source.entryPoint);
+
+	std::unique_ptr<ArgumentCache::Arguments> localArguments;
+	const ArgumentCache::Arguments* arguments = FrontEndArguments(options, source.stage, targetLanguage, localArguments);
+
+	std::vector<const wchar_t*, ShaderCompiler::ArenaAllocator<const wchar_t*>> dxcArgs{
+		ShaderCompiler::ArenaAllocator<const wchar_t*>(scratch.Get())
+	};
+	dxcArgs.reserve(arguments->pointers.size() + 4);
+	dxcArgs.insert(dxcArgs.end(), arguments->pointers.begin(), arguments->pointers.end());
+	dxcArgs.push_back(L"-T");
+	dxcArgs.push_back(arguments->profile.c_str());
+	dxcArgs.push_back(L"-E");
+	dxcArgs.push_back(entryPointUtf16);
+
+	CComPtr<IDxcIncludeHandler> includeHandler = new ScIncludeHandler(source.loadIncludeCallback, dxc.library);
+	CComPtr<IDxcOperationResult> preprocessResult;
+	IFT(dxc.compiler->Preprocess(sourceBlob, shaderNameUtf16, dxcArgs.data(), static_cast<UINT32>(dxcArgs.size()),
+															 defineSet->Defines(), defineSet->NumDefines(), includeHandler, &preprocessResult));
+
+	HRESULT status;
+	IFT(preprocessResult->GetStatus(&status));
+
+	Compiler::ResultDesc ret;
+
+	ret.target = nullptr;
+	ret.isText = true;
+	ret.errorWarningMsg = nullptr;
+
+	CComPtr<IDxcBlobEncoding> errors;
+	IFT(preprocessResult->GetErrorBuffer(&errors));
+	if ((errors != nullptr) && (errors->GetBufferSize() > 0))
+	{
+		ret.errorWarningMsg = CreateBlob(errors->GetBufferPointer(), static_cast<uint32_t>(errors->GetBufferSize()));
+	}
+
+	ret.hasError = true;
+	if (SUCCEEDED(status))
+	{
+		CComPtr<IDxcBlob> text;
+		IFT(preprocessResult->GetResult(&text));
+		if (text != nullptr)
+		{
+			ret.target = CreateBlob(text->GetBufferPointer(), static_cast<uint32_t>(text->GetBufferSize()));
+			ret.hasError = false;
+		}
+	}
+
+	return ret;
+}
+
+typedef std::unique_ptr<spirv_cross::CompilerGLSL, ShaderCompiler::ArenaDelete> CrossCompilerPtr;
+
+// Constructs a SPIRV-Cross backend from an already parsed module when there is one, parsing is the
+// bulk of the setup cost so sharing it across targets makes each extra target much cheaper.
+// The backend object itself lives in the arena, it never outlives the conversion
+template <typename T>
+CrossCompilerPtr CreateCrossCompiler(ShaderCompiler::Arena& arena, const spirv_cross::ParsedIR* parsedIr,
+																		 const uint32_t* spirvIr, size_t spirvSize)
+{
+	if (parsedIr != nullptr)
+	{
+		return CrossCompilerPtr(arena.New<T>(*parsedIr));
+	}
+	return CrossCompilerPtr(arena.New<T>(spirvIr, spirvSize));
+}
+
+ResultPtr ConvertBinary(const Compiler::ResultDesc& binaryResult, const Compiler::SourceDesc& source,
+												const Compiler::TargetDesc& target, const spirv_cross::ParsedIR* parsedIr)
 {
 	assert((target.language != ShadingLanguage::Dxil) && (target.language != ShadingLanguage::SpirV));
 	assert((binaryResult.target->Size() & (sizeof(uint32_t) - 1)) == 0);
 
-	Compiler::ResultDesc ret;
+	ScopedPhase phase(source, Compiler::Phase::Conversion);
+	ShaderCompiler::ArenaScope scratch;
+
+	// ret takes over the front end message, owned destroys it if the conversion throws
+	ResultPtr owned(new Compiler::ResultDesc{});
+	Compiler::ResultDesc& ret = *owned;
 
 	ret.target = nullptr;
 	ret.errorWarningMsg = binaryResult.errorWarningMsg;
+	ret.dxcPeakMemory = binaryResult.dxcPeakMemory;
 	ret.isText = true;
 
 	uint32_t intVersion = 0;
@@ -527,7 +1140,7 @@ Compiler::ResultDesc ConvertBinary(const Compiler::ResultDesc& binaryResult, con
 	const uint32_t* spirvIr = reinterpret_cast<const uint32_t*>(binaryResult.target->Data());
 	const size_t spirvSize = binaryResult.target->Size() / sizeof(uint32_t);
 
-	std::unique_ptr<spirv_cross::CompilerGLSL> compiler;
+	CrossCompilerPtr compiler;
 	bool combinedImageSamplers = false;
 	bool buildDummySampler = false;
 
@@ -539,29 +1152,29 @@ Compiler::ResultDesc ConvertBinary(const Compiler::ResultDesc& binaryResult, con
 		{
 			// Check https://github.com/KhronosGroup/SPIRV-Cross/issues/121 for details
 			AppendError(ret, "GS, HS, and DS has not been supported yet.");
-			return ret;
+			return owned;
 		}
 		if ((source.stage == ShaderStage::GeometryShader) && (intVersion < 40))
 		{
 			AppendError(ret, "HLSL shader model earlier than 4.0 doesn't have GS or CS.");
-			return ret;
+			return owned;
 		}
 		if ((source.stage == ShaderStage::ComputeShader) && (intVersion < 50))
 		{
 			AppendError(ret, "CS in HLSL shader model earlier than 5.0 is not supported.");
-			return ret;
+			return owned;
 		}
 		if (((source.stage == ShaderStage::HullShader) || (source.stage == ShaderStage::DomainShader)) && (intVersion < 50))
 		{
 			AppendError(ret, "HLSL shader model earlier than 5.0 doesn't have HS or DS.");
-			return ret;
+			return owned;
 		}
-		compiler = std::make_unique<spirv_cross::CompilerHLSL>(spirvIr, spirvSize);
+		compiler = CreateCrossCompiler<spirv_cross::CompilerHLSL>(scratch.Get(), parsedIr, spirvIr, spirvSize);
 		break;
 
 	case ShadingLanguage::Glsl:
 	case ShadingLanguage::Essl:
-		compiler = std::make_unique<spirv_cross::CompilerGLSL>(spirvIr, spirvSize);
+		compiler = CreateCrossCompiler<spirv_cross::CompilerGLSL>(scratch.Get(), parsedIr, spirvIr, spirvSize);
 		combinedImageSamplers = true;
 		buildDummySampler = true;
 		break;
@@ -571,9 +1184,9 @@ Compiler::ResultDesc ConvertBinary(const Compiler::ResultDesc& binaryResult, con
 		if (source.stage == ShaderStage::GeometryShader)
 		{
 			AppendError(ret, "MSL doesn't have GS.");
-			return ret;
+			return owned;
 		} else {
-			compiler = std::make_unique<spirv_cross::CompilerMSL>(spirvIr, spirvSize);
+			compiler = CreateCrossCompiler<spirv_cross::CompilerMSL>(scratch.Get(), parsedIr, spirvIr, spirvSize);
 		}
 		break;
 
@@ -639,7 +1252,7 @@ Compiler::ResultDesc ConvertBinary(const Compiler::ResultDesc& binaryResult, con
 			if (opts.version < 30)
 			{
 				AppendError(ret, "HLSL shader model earlier than 3.0 is not supported.");
-				return ret;
+				return owned;
 			}
 			hlslOpts.shader_model = opts.version;
 		}
@@ -722,8 +1335,7 @@ Compiler::ResultDesc ConvertBinary(const Compiler::ResultDesc& binaryResult, con
 
 	try
 	{
-		const std::string targetStr = compiler->compile();
-		ret.target = CreateBlob(targetStr.data(), static_cast<uint32_t>(targetStr.size()));
+		ret.target = new StringBlob(compiler->compile());
 		ret.hasError = false;
 	}
 	catch (spirv_cross::CompilerError& error)
@@ -734,7 +1346,40 @@ Compiler::ResultDesc ConvertBinary(const Compiler::ResultDesc& binaryResult, con
 		ret.hasError = true;
 	}
 
-	return ret;
+	return owned;
+}
+
+// Runs fn(0..count-1) through the source's parallelFor if it has one, otherwise in order on this thread.
+// An exception from any of them is rethrown once all of them are done
+void RunParallel(const Compiler::SourceDesc& source, uint32_t count, const std::function<void(uint32_t)>& fn)
+{
+	if (!source.parallelFor || (count < 2))
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			fn(i);
+		}
+		return;
+	}
+
+	std::vector<std::exception_ptr> errors(count);
+	source.parallelFor(count, [&fn, &errors](uint32_t i) {
+		try
+		{
+			fn(i);
+		}
+		catch (...)
+		{
+			errors[i] = std::current_exception();
+		}
+	});
+	for (const auto& error : errors)
+	{
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+	}
 }
 } // namespace
 
@@ -752,6 +1397,139 @@ void DestroyBlob(Blob* blob)
 	delete blob;
 }
 
+DefineSet* CreateDefineSet(const MacroDefine* defines, uint32_t numDefines)
+{
+	return new DefineSet(defines, numDefines);
+}
+
+void DestroyDefineSet(DefineSet* defineSet)
+{
+	delete defineSet;
+}
+
+const ArgumentCache::Arguments& ArgumentCache::Get(const Compiler::Options& options, ShaderStage stage,
+																									 ShadingLanguage targetLanguage)
+{
+	// DXIL or SPIR-V is all the target changes, every other language goes through SPIR-V
+	const bool dxil = targetLanguage == ShadingLanguage::Dxil;
+	const uint32_t key = (options.packMatricesInRowMajor ? 1u : 0u) | (options.enable16bitTypes ? 2u : 0u) |
+											 (options.enableDebugInfo ? 4u : 0u) | (options.disableOptimizations ? 8u : 0u) |
+											 ((static_cast<uint32_t>(options.optimizationLevel) & 0xFu) << 4) |
+											 (options.shaderModel.FullVersion() << 8) | (static_cast<uint32_t>(stage) << 16) |
+											 (dxil ? (1u << 24) : 0u);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto iter = m_arguments.find(key);
+	if (iter != m_arguments.end())
+	{
+		return *iter->second;
+	}
+
+	auto arguments = std::make_unique<Arguments>();
+	arguments->profile = ShaderProfile(stage, options);
+	arguments->strings = DxcArguments(options, dxil ? ShadingLanguage::Dxil : ShadingLanguage::SpirV);
+	arguments->pointers = DxcArgumentPointers(arguments->strings);
+	return *m_arguments.emplace(key, std::move(arguments)).first->second;
+}
+
+ArgumentCache* CreateArgumentCache()
+{
+	return new ArgumentCache();
+}
+
+void DestroyArgumentCache(ArgumentCache* argumentCache)
+{
+	delete argumentCache;
+}
+
+void PrebuildArguments(ArgumentCache* argumentCache, const Compiler::Options& options, ShadingLanguage targetLanguage)
+{
+	static const ShaderStage stages[] = { ShaderStage::VertexShader, ShaderStage::PixelShader,  ShaderStage::GeometryShader,
+																				ShaderStage::HullShader,   ShaderStage::DomainShader, ShaderStage::ComputeShader };
+	for (const auto stage : stages)
+	{
+		argumentCache->Get(options, stage, targetLanguage);
+	}
+}
+
+uint64_t DxcLiveMemory()
+{
+	return DxcMalloc::LiveBytes();
+}
+
+const char* ToolVersion()
+{
+	static const std::string version = []() {
+		std::string ret = "dxcompiler";
+		try
+		{
+			std::unique_ptr<DxcObjects> dxc = Dxcompiler::Instance().Acquire();
+			CComPtr<IDxcVersionInfo> info;
+			if (SUCCEEDED(dxc->compiler.QueryInterface(&info)))
+			{
+				UINT32 major = 0;
+				UINT32 minor = 0;
+				info->GetVersion(&major, &minor);
+				ret += " " + std::to_string(major) + "." + std::to_string(minor);
+
+				// The commit tells apart builds with the same version
+				CComPtr<IDxcVersionInfo2> info2;
+				UINT32 commitCount = 0;
+				char* commitHash = nullptr;
+				if (SUCCEEDED(info.QueryInterface(&info2)) && SUCCEEDED(info2->GetCommitInfo(&commitCount, &commitHash)))
+				{
+					ret += " " + std::to_string(commitCount) + " " + commitHash;
+					CoTaskMemFree(commitHash);
+				}
+			}
+			Dxcompiler::Instance().Release(std::move(dxc));
+		}
+		catch (std::exception&)
+		{
+			// Nothing compiles without it either
+			ret += " unavailable";
+		}
+
+		// SPIRV-Cross is built in, its C API version is the only version it has
+#if defined(SPVC_C_API_VERSION_MAJOR)
+		ret += " spirv-cross " + std::to_string(SPVC_C_API_VERSION_MAJOR) + "." + std::to_string(SPVC_C_API_VERSION_MINOR) +
+					 "." + std::to_string(SPVC_C_API_VERSION_PATCH);
+#else
+		ret += " spirv-cross unknown";
+#endif
+		return ret;
+	}();
+	return version.c_str();
+}
+
+Blob* DefaultLoadCallback(const char* includeName)
+{
+	Blob* blob = TryLoadIncludeFile(includeName);
+	if (blob == nullptr)
+	{
+		throw std::runtime_error(std::string("COULDN'T load included file ") + includeName + ".");
+	}
+	return blob;
+}
+
+Blob* TryLoadIncludeFile(const char* includeName)
+{
+	// Read into a blob of its own rather than mapped, the include cache can keep it for a long time and a
+	// mapping would see the file change under an unchanged hash (or fault if it is truncated)
+	std::ifstream includeFile(includeName, std::ios_base::in);
+	if (!includeFile)
+	{
+		return nullptr;
+	}
+	includeFile.seekg(0, std::ios::end);
+	std::string contents;
+	contents.resize(static_cast<size_t>(includeFile.tellg()));
+	includeFile.seekg(0, std::ios::beg);
+	includeFile.read(&contents[0], contents.size());
+	contents.resize(static_cast<size_t>(includeFile.gcount()));
+	return new StringBlob(std::move(contents));
+}
+
 Compiler::ResultDesc Compiler::Compile(const SourceDesc& source, const Options& options, const TargetDesc& target)
 {
 	ResultDesc result;
@@ -774,6 +1552,7 @@ void Compiler::Compile(const SourceDesc& source, const Options& options, const T
 
 	bool hasDxil = false;
 	bool hasSpirV = false;
+	uint32_t numTextTargets = 0;
 	for (uint32_t i = 0; i < numTargets; ++i)
 	{
 		if (targets[i].language == ShadingLanguage::Dxil)
@@ -783,39 +1562,88 @@ void Compiler::Compile(const SourceDesc& source, const Options& options, const T
 		else
 		{
 			hasSpirV = true;
+			if (targets[i].language != ShadingLanguage::SpirV)
+			{
+				++numTextTargets;
+			}
 		}
 	}
 
-	ResultDesc dxilBinaryResult{};
-	if (hasDxil)
+	ResultPtr dxilBinary;
+	ResultPtr spirvBinary;
+	if (hasDxil && hasSpirV)
 	{
-		dxilBinaryResult = CompileToBinary(sourceOverride, options, ShadingLanguage::Dxil);
+		// The two front end passes are independent, run them side by side on separate compiler instances.
+		// Each result is owned as soon as it exists so if either throws the other is still destroyed
+		ResultPtr* binaries[] = { &dxilBinary, &spirvBinary };
+		RunParallel(sourceOverride, 2, [&sourceOverride, &options, &binaries](uint32_t i) {
+			const ShadingLanguage language = (i == 0) ? ShadingLanguage::Dxil : ShadingLanguage::SpirV;
+			ScopedDxcObjects dxc(sourceOverride);
+			*binaries[i] = OwnResult(CompileToBinary(sourceOverride, options, language, dxc.Get()));
+		});
+	}
+	else if (hasDxil)
+	{
+		ScopedDxcObjects dxc(sourceOverride);
+		dxilBinary = OwnResult(CompileToBinary(sourceOverride, options, ShadingLanguage::Dxil, dxc.Get()));
+	}
+	else if (hasSpirV)
+	{
+		ScopedDxcObjects dxc(sourceOverride);
+		spirvBinary = OwnResult(CompileToBinary(sourceOverride, options, ShadingLanguage::SpirV, dxc.Get()));
 	}
 
+	// From here the front end blobs belong to the shares, targets get them (or references to them) not copies
+	ResultDesc dxilBinaryResult{};
 	ResultDesc spirvBinaryResult{};
-	if (hasSpirV)
+	if (dxilBinary)
+	{
+		ReleaseResult(dxilBinary, dxilBinaryResult);
+	}
+	if (spirvBinary)
 	{
-		spirvBinaryResult = CompileToBinary(sourceOverride, options, ShadingLanguage::SpirV);
+		ReleaseResult(spirvBinary, spirvBinaryResult);
+	}
+	const bool shareResults = numTargets > 1;
+	BlobShare dxilTarget(dxilBinaryResult.target, shareResults);
+	BlobShare dxilMessage(dxilBinaryResult.errorWarningMsg, shareResults);
+	BlobShare spirvTarget(spirvBinaryResult.target, shareResults);
+	BlobShare spirvMessage(spirvBinaryResult.errorWarningMsg, shareResults);
+
+	// With more than one text target parse the SPIR-V once, each backend then gets a copy of the IR
+	std::unique_ptr<spirv_cross::ParsedIR> sharedIr;
+	if ((numTextTargets > 1) && !spirvBinaryResult.hasError && (spirvTarget.Get() != nullptr))
+	{
+		ScopedPhase phase(sourceOverride, Phase::SpirvParse);
+		spirv_cross::Parser parser(reinterpret_cast<const uint32_t*>(spirvTarget.Get()->Data()),
+															 spirvTarget.Get()->Size() / sizeof(uint32_t));
+		parser.parse();
+		sharedIr = std::make_unique<spirv_cross::ParsedIR>(std::move(parser.get_parsed_ir()));
 	}
 
+	// Each text target is converted independently, they are gathered here and run in parallel after.
+	// Every result stays owned here until all the targets are done, so one that throws doesn't leak the others.
+	// A conversion that hasn't run yet owns just its front end message
+	std::vector<uint32_t> conversions;
+	std::vector<ResultDesc> conversionInputs(numTargets);
+	std::vector<ResultPtr> owned(numTargets);
+
 	for (uint32_t i = 0; i < numTargets; ++i)
 	{
-		ResultDesc binaryResult = targets[i].language == ShadingLanguage::Dxil ? dxilBinaryResult : spirvBinaryResult;
-		if (binaryResult.target)
-		{
-			binaryResult.target = CreateBlob(binaryResult.target->Data(), binaryResult.target->Size());
-		}
-		if (binaryResult.errorWarningMsg)
-		{
-			binaryResult.errorWarningMsg = CreateBlob(binaryResult.errorWarningMsg->Data(), binaryResult.errorWarningMsg->Size());
-		}
+		const bool isDxil = targets[i].language == ShadingLanguage::Dxil;
+		BlobShare& frontTarget = isDxil ? dxilTarget : spirvTarget;
+		ResultDesc binaryResult = isDxil ? dxilBinaryResult : spirvBinaryResult;
+		binaryResult.errorWarningMsg = (isDxil ? dxilMessage : spirvMessage).Take();
+		// Text targets only read the front end output
+		binaryResult.target = frontTarget.Get();
 		if (!binaryResult.hasError)
 		{
 			switch (targets[i].language)
 			{
 			case ShadingLanguage::Dxil:
 			case ShadingLanguage::SpirV:
-				results[i] = binaryResult;
+				binaryResult.target = frontTarget.Take();
+				owned[i] = OwnResult(binaryResult);
 				break;
 
 			case ShadingLanguage::Hlsl:
@@ -823,7 +1651,10 @@ void Compiler::Compile(const SourceDesc& source, const Options& options, const T
 			case ShadingLanguage::Essl:
 			case ShadingLanguage::Msl_macOS:
 			case ShadingLanguage::Msl_iOS:
-				results[i] = ConvertBinary(binaryResult, sourceOverride, targets[i]);
+				conversions.push_back(i);
+				conversionInputs[i] = binaryResult;
+				binaryResult.target = nullptr;
+				owned[i] = OwnResult(binaryResult);
 				break;
 
 			default:
@@ -833,20 +1664,44 @@ void Compiler::Compile(const SourceDesc& source, const Options& options, const T
 		}
 		else
 		{
-			results[i] = binaryResult;
+			binaryResult.target = frontTarget.Take();
+			owned[i] = OwnResult(binaryResult);
 		}
 	}
 
-	if (hasDxil)
+	const spirv_cross::ParsedIR* parsedIr = sharedIr.get();
+	RunParallel(sourceOverride, static_cast<uint32_t>(conversions.size()),
+				[&conversions, &conversionInputs, &owned, &sourceOverride, targets, parsedIr](uint32_t c) {
+					const uint32_t i = conversions[c];
+					// ConvertBinary takes over the message
+					conversionInputs[i].errorWarningMsg = owned[i]->errorWarningMsg;
+					owned[i]->errorWarningMsg = nullptr;
+					owned[i] = ConvertBinary(conversionInputs[i], sourceOverride, targets[i], parsedIr);
+				});
+
+	for (uint32_t i = 0; i < numTargets; ++i)
+	{
+		if (owned[i])
+		{
+			ReleaseResult(owned[i], results[i]);
+		}
+	}
+}
+
+Compiler::ResultDesc Compiler::Preprocess(const SourceDesc& source, const Options& options, ShadingLanguage targetLanguage)
+{
+	SourceDesc sourceOverride = source;
+	if (!sourceOverride.entryPoint || (strlen(sourceOverride.entryPoint) == 0))
 	{
-		DestroyBlob(dxilBinaryResult.target);
-		DestroyBlob(dxilBinaryResult.errorWarningMsg);
+		sourceOverride.entryPoint = "main";
 	}
-	if (hasSpirV)
+	if (!sourceOverride.loadIncludeCallback)
 	{
-		DestroyBlob(spirvBinaryResult.target);
-		DestroyBlob(spirvBinaryResult.errorWarningMsg);
+		sourceOverride.loadIncludeCallback = TryLoadIncludeFile;
 	}
+
+	ScopedDxcObjects dxc(sourceOverride);
+	return PreprocessToText(sourceOverride, options, targetLanguage, dxc.Get());
 }
 
 Compiler::ResultDesc Compiler::Disassemble(const DisassembleDesc& source)
@@ -889,10 +1744,11 @@ Compiler::ResultDesc Compiler::Disassemble(const DisassembleDesc& source)
 	}
 	else
 	{
+		ScopedDxcObjects dxc;
 		CComPtr<IDxcBlobEncoding> blob;
 		CComPtr<IDxcBlobEncoding> disassembly;
-		IFT(Dxcompiler::Instance().Library()->CreateBlobWithEncodingOnHeapCopy(source.binary, source.binarySize, CP_UTF8, &blob));
-		IFT(Dxcompiler::Instance().Compiler()->Disassemble(blob, &disassembly));
+		IFT(dxc.Get().library->CreateBlobWithEncodingOnHeapCopy(source.binary, source.binarySize, CP_UTF8, &blob));
+		IFT(dxc.Get().compiler->Disassemble(blob, &disassembly));
 
 		if (disassembly != nullptr)
 		{
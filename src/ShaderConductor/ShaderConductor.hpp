@@ -78,9 +78,34 @@ namespace ShaderConductor
     SC_API Blob* CreateBlob(const void* data, uint32_t size);
     SC_API void DestroyBlob(Blob* blob);
 
+    // Defines converted once into the form the DXC front end wants, a set shared by many compiles
+    // has no per compile conversion cost
+    class DefineSet;
+    SC_API DefineSet* CreateDefineSet(const MacroDefine* defines, uint32_t numDefines);
+    SC_API void DestroyDefineSet(DefineSet* defineSet);
+
+    // DXC command line arguments built once per distinct options, stage and target and reused by every
+    // compile that shares them
+    class ArgumentCache;
+
+    // reads an include from disk, throws if the file can't be read
+    SC_API Blob* DefaultLoadCallback(const char* includeName);
+    // the same but returns null if the file can't be read, DXC probes several paths per include and most
+    // don't exist. The include loader used when SourceDesc has no loadIncludeCallback
+    SC_API Blob* TryLoadIncludeFile(const char* includeName);
+
     class SC_API Compiler
     {
     public:
+        enum class Phase
+        {
+            AcquireCompiler, // Waiting for (or creating) a DXC library/compiler pair
+            FrontEnd,        // DXC, HLSL to DXIL or SPIR-V
+            Preprocess,      // DXC preprocessor only
+            SpirvParse,      // SPIRV-Cross parsing SPIR-V shared by several text targets
+            Conversion,      // SPIRV-Cross, SPIR-V to a text target
+        };
+
         struct ShaderModel
         {
             uint8_t major_ver : 6;
@@ -121,7 +146,13 @@ namespace ShaderConductor
             ShaderStage stage;
             const MacroDefine* defines;
             uint32_t numDefines;
+            const DefineSet* defineSet; // Optional, used instead of defines and numDefines if not null
             std::function<Blob*(const char* includeName)> loadIncludeCallback;
+            // Optional, called on the thread that ran each phase once it is done. Times are steady_clock nanoseconds (ShaderCompiler::NowNs)
+            std::function<void(Phase phase, uint64_t beginNs, uint64_t endNs)> phaseCallback;
+            // Optional, runs fn(0..count-1) side by side and returns once all are done. Used for the independent parts of a
+            // multi target compile (the DXIL and SPIR-V front ends, text conversions), they run one after another if null
+            std::function<void(uint32_t count, const std::function<void(uint32_t)>& fn)> parallelFor;
         };
 
         struct Options
@@ -133,6 +164,8 @@ namespace ShaderConductor
 
             int optimizationLevel = 3; // 0 to 3, no optimization to most optimization
             ShaderModel shaderModel = { 6, 0 };
+
+            ArgumentCache* argumentCache = nullptr; // Optional, arguments are built per compile if null
         };
 
         struct TargetDesc
@@ -144,10 +177,13 @@ namespace ShaderConductor
         struct ResultDesc
         {
             Blob* target;
-            bool isText;
+            bool isText; // Text targets are followed by a 0 that isn't included in their size
 
             Blob* errorWarningMsg;
             bool hasError;
+
+            // Most memory DXC held at once during the front end pass this result came from
+            uint64_t dxcPeakMemory = 0;
         };
 
         struct DisassembleDesc
@@ -161,8 +197,23 @@ namespace ShaderConductor
         static ResultDesc Compile(const SourceDesc& source, const Options& options, const TargetDesc& target);
         static void Compile(const SourceDesc& source, const Options& options, const TargetDesc* targets, uint32_t numTargets,
                             ResultDesc* results);
+        // Only the preprocessor, target is the expanded source text. targetLanguage picks the predefined
+        // macros, they match what a compile to that target would see
+        static ResultDesc Preprocess(const SourceDesc& source, const Options& options, ShadingLanguage targetLanguage);
         static ResultDesc Disassemble(const DisassembleDesc& source);
     };
+
+    SC_API ArgumentCache* CreateArgumentCache();
+    SC_API void DestroyArgumentCache(ArgumentCache* argumentCache);
+    // Builds the arguments for every stage up front so compiles with these options just look them up
+    SC_API void PrebuildArguments(ArgumentCache* argumentCache, const Compiler::Options& options, ShadingLanguage targetLanguage);
+
+    // Bytes DXC is holding right now, across every compile in the process
+    SC_API uint64_t DxcLiveMemory();
+
+    // The dxcompiler and SPIRV-Cross versions in use, results kept between runs are only valid for the same
+    // ones. Loads dxcompiler if it isn't already
+    SC_API const char* ToolVersion();
 } // namespace ShaderConductor
 
 #undef SC_API
@@ -0,0 +1,85 @@
+#include "al2o3_platform/platform.h"
+#include "al2o3_memory/memory.h"
+#include "arena.hpp"
+#include "utf_transcode.hpp"
+#include <cstring>
+#include <cwchar>
+
+namespace ShaderCompiler {
+
+namespace {
+// big enough that a typical compile never needs a second block
+size_t const BlockSize = 64 * 1024;
+// blocks a thread keeps once it is back at the start
+size_t const RetainedBlocks = 4;
+} // end anon namespace
+
+Arena::~Arena() {
+	for (auto const& block : blocks) {
+		MEMORY_FREE(block.data);
+	}
+}
+
+Arena& Arena::ThreadLocal() {
+	static thread_local Arena arena;
+	return arena;
+}
+
+void *Arena::Allocate(size_t size, size_t alignment) {
+	if (current < blocks.size()) {
+		Block const& block = blocks[current];
+		uintptr_t const start = (uintptr_t) block.data;
+		uintptr_t const aligned = (start + used + alignment - 1) & ~(uintptr_t) (alignment - 1);
+		if (aligned + size <= start + block.size) {
+			used = (aligned - start) + size;
+			return (void *) aligned;
+		}
+		current++;
+	}
+
+	// the next retained block if it is big enough, otherwise a new one goes in before it
+	size_t const needed = size + alignment - 1;
+	if (current == blocks.size() || blocks[current].size < needed) {
+		size_t const blockSize = needed > BlockSize ? needed : BlockSize;
+		Block block{(uint8_t *) MEMORY_MALLOC(blockSize), blockSize};
+		if (!block.data) throw std::bad_alloc();
+		blocks.insert(blocks.begin() + current, block);
+	}
+
+	uintptr_t const start = (uintptr_t) blocks[current].data;
+	uintptr_t const aligned = (start + alignment - 1) & ~(uintptr_t) (alignment - 1);
+	used = (aligned - start) + size;
+	return (void *) aligned;
+}
+
+void Arena::Rewind(Marker const& marker) {
+	current = marker.block;
+	used = marker.used;
+
+	if (current == 0 && used == 0) {
+		while (blocks.size() > RetainedBlocks) {
+			MEMORY_FREE(blocks.back().data);
+			blocks.pop_back();
+		}
+	}
+}
+
+wchar_t const *ArenaUtf8ToWide(Arena& arena, char const *utf8) {
+	size_t const size = strlen(utf8);
+	wchar_t *wide = (wchar_t *) arena.Allocate((Utf8ToWideMaxLength(size) + 1) * sizeof(wchar_t), alignof(wchar_t));
+	size_t const count = Utf8ToWide(utf8, size, wide);
+	if (count == TranscodeError) return nullptr;
+	wide[count] = 0;
+	return wide;
+}
+
+char const *ArenaWideToUtf8(Arena& arena, wchar_t const *wide) {
+	size_t const count = wcslen(wide);
+	char *utf8 = (char *) arena.Allocate(WideToUtf8MaxLength(count) + 1, 1);
+	size_t const size = WideToUtf8(wide, count, utf8);
+	if (size == TranscodeError) return nullptr;
+	utf8[size] = 0;
+	return utf8;
+}
+
+} // namespace ShaderCompiler
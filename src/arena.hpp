@@ -0,0 +1,105 @@
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include <cstddef>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ShaderCompiler {
+
+// bump allocator for memory that only lives as long as one compile. blocks come from al2o3_memory and
+// are kept for reuse, so a thread compiling over and over stops going to the global heap (and contending
+// with every other compiling thread on it) for its transients once it has warmed up.
+// not thread safe, each thread has its own (ThreadLocal). free is a no op, memory comes back when the
+// ArenaScope it was allocated under ends
+class Arena {
+public:
+	struct Marker {
+		size_t block;
+		size_t used;
+	};
+
+	Arena() = default;
+	~Arena();
+	Arena(Arena const&) = delete;
+	Arena& operator=(Arena const&) = delete;
+
+	static Arena& ThreadLocal();
+
+	// throws std::bad_alloc if a new block can't be had
+	void *Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+	template<typename T, typename... Args>
+	T *New(Args&&... args) {
+		return new(Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	Marker Mark() const { return Marker{current, used}; }
+	// everything allocated since the mark is gone, rewinding to the very start also hands back all but a
+	// few blocks so one huge compile doesn't pin its memory to the thread forever
+	void Rewind(Marker const& marker);
+
+private:
+	struct Block {
+		uint8_t *data;
+		size_t size;
+	};
+
+	std::vector<Block> blocks;
+	size_t current = 0;
+	size_t used = 0;
+};
+
+// everything allocated from the arena while this is alive goes when it ends, scopes nest
+class ArenaScope {
+public:
+	explicit ArenaScope(Arena& arena = Arena::ThreadLocal()) : arena(arena), marker(arena.Mark()) {}
+	~ArenaScope() { arena.Rewind(marker); }
+	ArenaScope(ArenaScope const&) = delete;
+	ArenaScope& operator=(ArenaScope const&) = delete;
+
+	Arena& Get() const { return arena; }
+
+private:
+	Arena& arena;
+	Arena::Marker const marker;
+};
+
+// standard allocator over an arena, for containers that don't outlive the scope they were made in
+template<typename T>
+class ArenaAllocator {
+public:
+	typedef T value_type;
+
+	explicit ArenaAllocator(Arena& arena) : arena(&arena) {}
+	template<typename U>
+	ArenaAllocator(ArenaAllocator<U> const& other) : arena(other.arena) {}
+
+	T *allocate(size_t count) { return (T *) arena->Allocate(count * sizeof(T), alignof(T)); }
+	void deallocate(T *, size_t) {}
+
+	template<typename U>
+	bool operator==(ArenaAllocator<U> const& other) const { return arena == other.arena; }
+	template<typename U>
+	bool operator!=(ArenaAllocator<U> const& other) const { return arena != other.arena; }
+
+private:
+	template<typename U> friend class ArenaAllocator;
+	Arena *arena;
+};
+
+// for objects made with Arena::New, runs the destructor and leaves the memory to the scope
+struct ArenaDelete {
+	template<typename T>
+	void operator()(T *object) const { object->~T(); }
+};
+
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
+
+// 0 terminated conversions into arena memory, nullptr if the input isn't valid
+wchar_t const *ArenaUtf8ToWide(Arena& arena, char const *utf8);
+char const *ArenaWideToUtf8(Arena& arena, wchar_t const *wide);
+
+} // namespace ShaderCompiler
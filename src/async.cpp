@@ -0,0 +1,134 @@
+#include "al2o3_platform/platform.h"
+#include "al2o3_memory/memory.h"
+#include "async.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <mutex>
+
+typedef struct ShaderCompiler_Ticket {
+	// one ref for the caller (dropped by finish), one for the worker (dropped after the callback)
+	std::atomic<uint32_t> refCount;
+	bool complete;
+	bool succeeded;
+	ShaderCompiler_Output output;
+} ShaderCompiler_Ticket;
+
+namespace {
+
+// completion is rare compared to the work so every ticket shares one lock, which is what
+// lets WaitAny wait on tickets from different contexts
+std::mutex& CompletionMutex() {
+	static std::mutex mutex;
+	return mutex;
+}
+
+std::condition_variable& CompletionCondition() {
+	static std::condition_variable condition;
+	return condition;
+}
+
+void ReleaseTicket(ShaderCompiler_Ticket *ticket) {
+	if (--ticket->refCount == 0) {
+		delete ticket;
+	}
+}
+
+} // end anon namespace
+
+namespace ShaderCompiler {
+
+ShaderCompiler_TicketHandle SubmitAsync(ThreadPool& pool,
+																				AsyncWork&& work,
+																				ShaderCompiler_CompletionCallback callback,
+																				void *userData) {
+	auto ticket = new ShaderCompiler_Ticket();
+	ticket->refCount = 2;
+	ticket->complete = false;
+	ticket->succeeded = false;
+	memset(&ticket->output, 0, sizeof(ShaderCompiler_Output));
+
+	pool.Submit([ticket, work, callback, userData]() {
+		ShaderCompiler_Output output;
+		memset(&output, 0, sizeof(ShaderCompiler_Output));
+		// an exception (out of memory...) would end the process on a pool thread, the ticket fails instead
+		// so whoever waits on it still returns
+		bool succeeded = false;
+		try {
+			succeeded = work(&output);
+		} catch (std::exception const &e) {
+			LOGERROR(e.what());
+			ShaderCompiler_FreeOutput(&output);
+		} catch (...) {
+			LOGERROR("Async shader compile failed with an unknown exception");
+			ShaderCompiler_FreeOutput(&output);
+		}
+		{
+			std::lock_guard<std::mutex> lock(CompletionMutex());
+			ticket->output = output;
+			ticket->succeeded = succeeded;
+			ticket->complete = true;
+		}
+		CompletionCondition().notify_all();
+
+		if (callback) {
+			callback(ticket, userData);
+		}
+		ReleaseTicket(ticket);
+	});
+
+	return ticket;
+}
+
+} // namespace ShaderCompiler
+
+AL2O3_EXTERN_C bool ShaderCompiler_IsComplete(ShaderCompiler_TicketHandle ticket) {
+	if (!ticket) return false;
+	std::lock_guard<std::mutex> lock(CompletionMutex());
+	return ticket->complete;
+}
+
+AL2O3_EXTERN_C void ShaderCompiler_Wait(ShaderCompiler_TicketHandle ticket) {
+	if (!ticket) return;
+	std::unique_lock<std::mutex> lock(CompletionMutex());
+	CompletionCondition().wait(lock, [ticket]() { return ticket->complete; });
+}
+
+AL2O3_EXTERN_C uint32_t ShaderCompiler_WaitAny(ShaderCompiler_TicketHandle const *tickets, uint32_t ticketCount) {
+	if (!tickets || ticketCount == 0) return ~0u;
+
+	// with only null tickets nothing can ever complete
+	bool anyTicket = false;
+	for (uint32_t i = 0; i < ticketCount; ++i) {
+		if (tickets[i]) anyTicket = true;
+	}
+	if (!anyTicket) return ~0u;
+
+	uint32_t index = ~0u;
+	std::unique_lock<std::mutex> lock(CompletionMutex());
+	CompletionCondition().wait(lock, [&]() {
+		for (uint32_t i = 0; i < ticketCount; ++i) {
+			if (tickets[i] && tickets[i]->complete) {
+				index = i;
+				return true;
+			}
+		}
+		return false;
+	});
+	return index;
+}
+
+AL2O3_EXTERN_C bool ShaderCompiler_FinishAsync(ShaderCompiler_TicketHandle ticket, ShaderCompiler_Output *output) {
+	if (!ticket) return false;
+	ShaderCompiler_Wait(ticket);
+
+	bool const succeeded = ticket->succeeded;
+	if (output) {
+		*output = ticket->output;
+	} else {
+		ShaderCompiler_FreeOutput(&ticket->output);
+	}
+	ReleaseTicket(ticket);
+	return succeeded;
+}
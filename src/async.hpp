@@ -0,0 +1,18 @@
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include "gfx_shadercompiler/compiler.h"
+#include "thread_pool.hpp"
+#include <functional>
+
+namespace ShaderCompiler {
+
+// does the work on pool and returns a ticket for it, work fills output and returns success.
+// the ShaderCompiler_ wait/finish functions operate on the returned ticket
+typedef std::function<bool(ShaderCompiler_Output *output)> AsyncWork;
+ShaderCompiler_TicketHandle SubmitAsync(ThreadPool& pool,
+																				AsyncWork&& work,
+																				ShaderCompiler_CompletionCallback callback,
+																				void *userData);
+
+} // namespace ShaderCompiler
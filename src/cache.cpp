@@ -0,0 +1,159 @@
+#include "al2o3_platform/platform.h"
+#include "al2o3_memory/memory.h"
+#include "cache.hpp"
+#include "ShaderConductor/ShaderConductor.hpp"
+
+namespace ShaderCompiler {
+
+namespace {
+// a Blob viewing a shared entry's shader, what ShaderCompiler_FreeOutput destroys for a shared output
+class CachedOutputBlob : public ShaderConductor::Blob {
+public:
+	explicit CachedOutputBlob(std::shared_ptr<CachedOutput const> entry) : entry(std::move(entry)) {}
+
+	void const *Data() const override { return entry->shader.data(); }
+	uint32_t Size() const override { return (uint32_t) entry->shader.size(); }
+
+private:
+	std::shared_ptr<CachedOutput const> entry;
+};
+
+char const *CopyLog(std::string const& log) {
+	char *mem = (char *) MEMORY_MALLOC(log.size() + 1);
+	memcpy(mem, log.data(), log.size());
+	mem[log.size()] = 0;
+	return mem;
+}
+} // end anon namespace
+
+size_t CachedOutput::Footprint() const {
+	size_t size = sizeof(CachedOutput) + shader.size() + log.size();
+	for (auto const& include : includes) {
+		size += sizeof(IncludeDependency) + include.name.size();
+	}
+	return size;
+}
+
+void CachedOutput::CopyTo(ShaderCompiler_Output *output) const {
+	memset(output, 0, sizeof(ShaderCompiler_Output));
+	if (!shader.empty()) {
+		void *mem = MEMORY_MALLOC(shader.size());
+		memcpy(mem, shader.data(), shader.size());
+		output->shader = mem;
+		output->shaderSize = shader.size();
+	}
+	if (hasLog) {
+		output->log = CopyLog(log);
+	}
+}
+
+void CachedOutput::ShareTo(std::shared_ptr<CachedOutput const> const& entry, ShaderCompiler_Output *output) {
+	memset(output, 0, sizeof(ShaderCompiler_Output));
+	if (!entry->shader.empty()) {
+		output->shader = entry->shader.data();
+		output->shaderSize = entry->shader.size();
+		output->owner = new CachedOutputBlob(entry);
+	}
+	// the log is freed on its own so is still a copy, it is small
+	if (entry->hasLog) {
+		output->log = CopyLog(entry->log);
+	}
+}
+
+std::shared_ptr<CachedOutput> CachedOutput::From(ShaderCompiler_Output const *output,
+																								 bool succeeded,
+																								 std::vector<IncludeDependency>&& includes) {
+	auto entry = std::make_shared<CachedOutput>();
+	entry->succeeded = succeeded;
+	if (output->shader) {
+		uint8_t const *bytes = (uint8_t const *) output->shader;
+		entry->shader.assign(bytes, bytes + output->shaderSize);
+	}
+	entry->hasLog = (output->log != nullptr);
+	if (entry->hasLog) {
+		entry->log = output->log;
+	}
+	entry->includes = std::move(includes);
+	return entry;
+}
+
+bool ValidateIncludes(CachedOutput const& entry, ValidateIncludeFunc validate, void *user) {
+	for (auto const& include : entry.includes) {
+		if (!validate(user, include)) return false;
+	}
+	return true;
+}
+
+void OutputCache::SetBudget(uint64_t newBudget) {
+	std::lock_guard<std::mutex> lock(mutex);
+	budget = newBudget;
+	Evict(newBudget);
+}
+
+OutputCache::EntryPtr OutputCache::Lookup(Hash128 const& key, ValidateIncludeFunc validate, void *user) {
+	EntryPtr entry;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = map.find(key);
+		if (it != map.end()) {
+			entry = it->second->second;
+			lru.splice(lru.begin(), lru, it->second);
+		}
+	}
+
+	// include validation calls back into user code so is done without the lock held
+	if (entry && !ValidateIncludes(*entry, validate, user)) {
+		entry.reset();
+	}
+
+	if (entry) {
+		hits++;
+	} else {
+		misses++;
+	}
+	return entry;
+}
+
+void OutputCache::Insert(Hash128 const& key, EntryPtr const& entry) {
+	size_t const size = entry->Footprint();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	uint64_t const limit = budget;
+	if (size > limit) return;
+
+	auto it = map.find(key);
+	if (it != map.end()) {
+		totalSize -= it->second->second->Footprint();
+		lru.erase(it->second);
+		map.erase(it);
+	}
+
+	Evict(limit - size);
+	lru.emplace_front(key, entry);
+	map[key] = lru.begin();
+	totalSize += size;
+}
+
+void OutputCache::Clear() {
+	std::lock_guard<std::mutex> lock(mutex);
+	Evict(0);
+}
+
+void OutputCache::GetStats(ShaderCompiler_CacheStats *stats) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	stats->hits = hits;
+	stats->misses = misses;
+	stats->entryCount = map.size();
+	stats->sizeInBytes = totalSize;
+}
+
+void OutputCache::Evict(uint64_t limit) {
+	while (totalSize > limit && !lru.empty()) {
+		auto const& last = lru.back();
+		totalSize -= last.second->Footprint();
+		map.erase(last.first);
+		lru.pop_back();
+	}
+}
+
+} // namespace ShaderCompiler
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include "gfx_shadercompiler/compiler.h"
+#include "hash.hpp"
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ShaderCompiler {
+
+// an include the compile pulled in and the hash of what it contained at the time
+struct IncludeDependency {
+	std::string name;
+	Hash128 contentHash;
+};
+// the contentHash of an include the compile looked for and didn't find, the entry is only valid while it
+// is still missing (it may be one of the paths DXC tries before the one that is found).
+// not 0, that is what an empty file hashes to
+Hash128 const MissingInclude{~0ull, ~0ull};
+
+// the result of a compile, failures are kept (with their error log) so a broken shader isn't
+// recompiled until it or something it includes changes
+struct CachedOutput {
+	std::vector<uint8_t> shader;
+	std::string log;
+	bool hasLog;
+	bool succeeded;
+	std::vector<IncludeDependency> includes;
+
+	size_t Footprint() const;
+	// copies into a freshly allocated output the caller owns (same as a real compile)
+	void CopyTo(ShaderCompiler_Output *output) const;
+	// the same but output->shader is the entry's own memory, output->owner keeps the entry alive until
+	// ShaderCompiler_FreeOutput so any number of outputs can share one result
+	static void ShareTo(std::shared_ptr<CachedOutput const> const& entry, ShaderCompiler_Output *output);
+	static std::shared_ptr<CachedOutput> From(ShaderCompiler_Output const *output,
+																						bool succeeded,
+																						std::vector<IncludeDependency>&& includes);
+};
+
+typedef bool (*ValidateIncludeFunc)(void *user, IncludeDependency const& include);
+// true if every include the entry was built with still has the same contents
+bool ValidateIncludes(CachedOutput const& entry, ValidateIncludeFunc validate, void *user);
+
+// bounded LRU of compile results keyed on a hash of everything that went into the compile.
+// includes can't be known until a compile has run, so each entry remembers what it included
+// and the caller validates those are unchanged before a hit is reported
+class OutputCache {
+public:
+	typedef std::shared_ptr<CachedOutput const> EntryPtr;
+
+	explicit OutputCache(uint64_t budget) : budget(budget), totalSize(0), hits(0), misses(0) {}
+
+	// called on every compile so doesn't take the lock, budget is only changed with it held
+	bool Enabled() const { return budget.load() != 0; }
+	void SetBudget(uint64_t newBudget);
+
+	// returns the entry if present and its includes validate
+	EntryPtr Lookup(Hash128 const& key, ValidateIncludeFunc validate, void *user);
+	void Insert(Hash128 const& key, EntryPtr const& entry);
+	void Clear();
+
+	void GetStats(ShaderCompiler_CacheStats *stats) const;
+
+private:
+	typedef std::list<std::pair<Hash128, EntryPtr>> LruList;
+
+	void Evict(uint64_t limit);
+
+	mutable std::mutex mutex;
+	LruList lru;
+	std::unordered_map<Hash128, LruList::iterator, Hash128Hasher> map;
+	std::atomic<uint64_t> budget;
+	uint64_t totalSize;
+
+	std::atomic<uint64_t> hits;
+	std::atomic<uint64_t> misses;
+};
+
+} // namespace ShaderCompiler
@@ -0,0 +1,191 @@
+#include "al2o3_platform/platform.h"
+#include "capture.hpp"
+#include <cstring>
+
+namespace ShaderCompiler {
+
+namespace {
+char const Magic[4] = {'S', 'C', 'C', 'P'};
+uint32_t const Version = 1;
+
+enum RecordType : uint8_t {
+	RT_Include = 1,
+	RT_Source = 2,
+	RT_Compile = 3,
+};
+
+// the writes return false if they were short (disk full...)
+template<typename T>
+bool Write(FILE *file, T const& value) {
+	return fwrite(&value, sizeof(T), 1, file) == 1;
+}
+
+bool WriteString(FILE *file, char const *str) {
+	uint32_t const size = str ? (uint32_t) strlen(str) : 0;
+	return Write(file, size) && (size == 0 || fwrite(str, 1, size, file) == size);
+}
+
+bool WriteBytes(FILE *file, void const *data, size_t size) {
+	return Write(file, (uint64_t) size) && (size == 0 || fwrite(data, 1, size, file) == size);
+}
+
+template<typename T>
+bool Read(FILE *file, T& value) {
+	return fread(&value, sizeof(T), 1, file) == 1;
+}
+
+template<typename Size>
+bool ReadSized(FILE *file, std::string& out) {
+	Size size;
+	if (!Read(file, size)) return false;
+	out.resize((size_t) size);
+	return size == 0 || fread(&out[0], 1, (size_t) size, file) == (size_t) size;
+}
+
+bool ReadCompile(FILE *file, CaptureCompile& compile) {
+	uint32_t defineCount;
+	uint8_t succeeded;
+	if (!Read(file, compile.source) ||
+			!Read(file, compile.shaderType) ||
+			!Read(file, compile.inputLanguage) ||
+			!Read(file, compile.outputType) ||
+			!Read(file, compile.outputVersion) ||
+			!Read(file, compile.optimizationLevel) ||
+			!ReadSized<uint32_t>(file, compile.name) ||
+			!ReadSized<uint32_t>(file, compile.entryPoint) ||
+			!Read(file, defineCount)) {
+		return false;
+	}
+	compile.defines.resize(defineCount);
+	for (auto& define : compile.defines) {
+		uint8_t hasValue;
+		if (!ReadSized<uint32_t>(file, define.name) ||
+				!Read(file, hasValue) ||
+				!ReadSized<uint32_t>(file, define.value)) {
+			return false;
+		}
+		define.hasValue = hasValue != 0;
+	}
+	if (!Read(file, compile.durationNs) || !Read(file, succeeded)) return false;
+	compile.succeeded = succeeded != 0;
+	return true;
+}
+} // end anon namespace
+
+std::unique_ptr<CaptureWriter> CaptureWriter::Create(char const *path) {
+	FILE *file = fopen(path, "wb");
+	if (!file) return nullptr;
+
+	if (fwrite(Magic, 1, sizeof(Magic), file) != sizeof(Magic) || !Write(file, Version)) {
+		fclose(file);
+		return nullptr;
+	}
+	return std::unique_ptr<CaptureWriter>(new CaptureWriter(file));
+}
+
+CaptureWriter::~CaptureWriter() {
+	if (file) fclose(file);
+}
+
+void CaptureWriter::Stop(bool ok) {
+	if (ok) return;
+	// a record cut short ends the file, Capture::Read keeps everything before it
+	LOGERROR("Shader capture couldn't be written, capture stopped");
+	fclose(file);
+	file = nullptr;
+}
+
+void CaptureWriter::Include(char const *name, void const *data, size_t size) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!file) return;
+
+	Stop(Write(file, (uint8_t) RT_Include) &&
+			 WriteString(file, name) &&
+			 WriteBytes(file, data, size));
+}
+
+void CaptureWriter::Compile(CaptureCompile const& compile, char const *source) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!file) return;
+
+	bool ok = true;
+	if (sources.insert(compile.source).second) {
+		ok = Write(file, (uint8_t) RT_Source) &&
+				Write(file, compile.source) &&
+				WriteBytes(file, source, strlen(source));
+	}
+
+	ok = ok &&
+			Write(file, (uint8_t) RT_Compile) &&
+			Write(file, compile.source) &&
+			Write(file, compile.shaderType) &&
+			Write(file, compile.inputLanguage) &&
+			Write(file, compile.outputType) &&
+			Write(file, compile.outputVersion) &&
+			Write(file, compile.optimizationLevel) &&
+			WriteString(file, compile.name.c_str()) &&
+			WriteString(file, compile.entryPoint.c_str()) &&
+			Write(file, (uint32_t) compile.defines.size());
+	for (size_t i = 0; ok && i < compile.defines.size(); ++i) {
+		CaptureDefine const& define = compile.defines[i];
+		ok = WriteString(file, define.name.c_str()) &&
+				Write(file, (uint8_t) define.hasValue) &&
+				WriteString(file, define.value.c_str());
+	}
+	ok = ok &&
+			Write(file, compile.durationNs) &&
+			Write(file, (uint8_t) compile.succeeded) &&
+			// a crash part way through a session still leaves everything before it readable
+			fflush(file) == 0;
+	Stop(ok);
+}
+
+bool Capture::Read(char const *path) {
+	FILE *file = fopen(path, "rb");
+	if (!file) return false;
+
+	char magic[4];
+	uint32_t version;
+	bool ok = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+			memcmp(magic, Magic, sizeof(Magic)) == 0 &&
+			ShaderCompiler::Read(file, version) && version == Version;
+
+	uint8_t type;
+	while (ok && ShaderCompiler::Read(file, type)) {
+		switch (type) {
+		case RT_Include: {
+			Include include;
+			ok = ReadSized<uint32_t>(file, include.name) && ReadSized<uint64_t>(file, include.contents);
+			if (ok) {
+				include.contentHash = Hasher::Of(include.contents.data(), include.contents.size());
+				records.push_back({Record::IncludeRecord, (uint32_t) includes.size()});
+				includes.push_back(std::move(include));
+			}
+			break;
+		}
+		case RT_Source: {
+			Hash128 hash;
+			std::string source;
+			ok = ShaderCompiler::Read(file, hash) && ReadSized<uint64_t>(file, source);
+			if (ok) sources[hash] = std::move(source);
+			break;
+		}
+		case RT_Compile: {
+			CaptureCompile compile;
+			ok = ReadCompile(file, compile) && sources.count(compile.source) != 0;
+			if (ok) {
+				records.push_back({Record::CompileRecord, (uint32_t) compiles.size()});
+				compiles.push_back(std::move(compile));
+			}
+			break;
+		}
+		default: ok = false;
+			break;
+		}
+	}
+
+	fclose(file);
+	return ok;
+}
+
+} // namespace ShaderCompiler
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include "hash.hpp"
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace ShaderCompiler {
+
+// capture files record the compiles a context did so they can be run again elsewhere (benchmarks/capture_replay.cpp).
+// a header then records in the order they happened:
+//   include  an include name and the contents the context loaded for it, written every time it is (re)loaded
+//   source   a shader source, written once per distinct source
+//   compile  the settings, defines and source (by hash) of a compile, written once it is done so every
+//            include it loaded is before it in the file
+// values are in the byte order of the machine that wrote it
+struct CaptureDefine {
+	std::string name;
+	std::string value;
+	bool hasValue;
+};
+
+struct CaptureCompile {
+	Hash128 source;
+	// ShaderCompiler_ enums as they were for the compile
+	uint32_t shaderType;
+	uint32_t inputLanguage;
+	uint32_t outputType;
+	uint32_t outputVersion;
+	uint32_t optimizationLevel;
+	std::string name;
+	std::string entryPoint;
+	std::vector<CaptureDefine> defines;
+	// how long it took when it was recorded
+	uint64_t durationNs;
+	bool succeeded;
+};
+
+// appends to a capture file, safe to use from any number of threads. The first write that fails
+// (disk full...) is logged and ends the capture, what was written before it can still be read
+class CaptureWriter {
+public:
+	// null if the file can't be created
+	static std::unique_ptr<CaptureWriter> Create(char const *path);
+	~CaptureWriter();
+	CaptureWriter(CaptureWriter const&) = delete;
+	CaptureWriter& operator=(CaptureWriter const&) = delete;
+
+	void Include(char const *name, void const *data, size_t size);
+	// source is the 0 terminated text compile.source is the hash of
+	void Compile(CaptureCompile const& compile, char const *source);
+
+private:
+	explicit CaptureWriter(FILE *file) : file(file) {}
+	// closes the file if ok is false
+	void Stop(bool ok);
+
+	// null once a write has failed
+	FILE *file;
+	std::mutex mutex;
+	std::unordered_set<Hash128, Hash128Hasher> sources;
+};
+
+// a whole capture file read back
+struct Capture {
+	struct Include {
+		std::string name;
+		std::string contents;
+		Hash128 contentHash;
+	};
+
+	// includes and compiles interleaved as they were recorded, index is into includes or compiles
+	struct Record {
+		enum Type { IncludeRecord, CompileRecord } type;
+		uint32_t index;
+	};
+
+	std::vector<Include> includes;
+	std::vector<CaptureCompile> compiles;
+	std::vector<Record> records;
+	std::unordered_map<Hash128, std::string, Hash128Hasher> sources;
+
+	// false if the file can't be read or isn't a capture. A file cut short (the process recording it died)
+	// also returns false but keeps every record before the cut
+	bool Read(char const *path);
+};
+
+} // namespace ShaderCompiler
@@ -4,6 +4,17 @@
 #include "gfx_shadercompiler/compiler.h"
 #include "ShaderConductor/ShaderConductor.hpp"
 #include "al2o3_vfile/memory.h"
+#include "async.hpp"
+#include "cache.hpp"
+#include "capture.hpp"
+#include "defines.hpp"
+#include "disk_cache.hpp"
+#include "include_cache.hpp"
+#include "single_flight.hpp"
+#include "thread_pool.hpp"
+#include "timing.hpp"
+#include "trace.hpp"
+#include <algorithm>
 
 #if defined(SUPPORT_GLSL)
 #include "shaderc/shaderc.h"
@@ -111,6 +122,56 @@ static void ScOptimizationConverter(ShaderCompiler_Optimizations optimizations,
 
 	}
 }
+// fills in the ShaderConductor target for an output type, DXIL and HLSL versions
+// are shader models and so also set the front end options
+static void ScTargetConverter(ShaderCompiler_OutputType output,
+															uint32_t outputVersion,
+															ShaderConductor::Compiler::TargetDesc& target,
+															ShaderConductor::Compiler::Options& options) {
+	target.version = nullptr;
+
+	switch (output) {
+	case ShaderCompiler_OT_SPIRV:
+		target.language = ShaderConductor::ShadingLanguage::SpirV;
+		break;
+	case ShaderCompiler_OT_DXIL:
+		if(outputVersion == 0) outputVersion = 60;
+		target.language = ShaderConductor::ShadingLanguage::Dxil;
+		options.shaderModel.major_ver = (outputVersion / 10);
+		options.shaderModel.minor_ver = (outputVersion % 10);
+		break;
+	case ShaderCompiler_OT_HLSL:
+		if(outputVersion == 0) outputVersion = 60;
+		target.language  = ShaderConductor::ShadingLanguage::Hlsl;
+		options.shaderModel.major_ver = (outputVersion / 10);
+		options.shaderModel.minor_ver = (outputVersion % 10);
+		break;
+
+	case ShaderCompiler_OT_GLSL:
+		if(outputVersion == 0) outputVersion = 450;
+
+		target.language = ShaderConductor::ShadingLanguage::Glsl;
+		switch (outputVersion) {
+		case 300: target.version = "300";
+			break;
+		case 400: target.version = "400";
+			break;
+		default:
+		case 450: target.version = "450";
+			break;
+		}
+		break;
+	case ShaderCompiler_OT_MSL_OSX:
+		target.language = ShaderConductor::ShadingLanguage::Msl_macOS;
+		target.version = "20";
+		break;
+	case ShaderCompiler_OT_MSL_IOS:
+		target.language = ShaderConductor::ShadingLanguage::Msl_iOS;
+		target.version = "20";
+		break;
+	}
+}
+
 static char const *CopyString(char const *msg) {
 	size_t const msgSize = strlen(msg);
 	char *log = (char *) MEMORY_MALLOC(msgSize + 1);
@@ -128,21 +189,139 @@ static char const *CopyString(char const *msg, size_t const msgSize) {
 typedef struct ShaderCompiler_Context {
 	ShaderCompiler_Language inputLanguage;
 	ShaderCompiler_OutputType outputType;
+	uint32_t outputVersion;
+	ShaderCompiler_Optimizations optimizationLevel;
 
 	// shader conductor settings
 	ShaderConductor::Compiler::Options scOptions;
 	ShaderConductor::Compiler::TargetDesc scTarget;
+	// DXC arguments for the current settings, rebuilt when they change so compiles don't
+	ShaderConductor::ArgumentCache* scArgumentCache;
+
+	// tiered compiles, the fast tier is the settings above without optimisation (argument cache null unless on)
+	ShaderCompiler_TieredCallback tieredCallback;
+	void* tieredUserData;
+	ShaderConductor::Compiler::Options scFastOptions;
+	ShaderConductor::ArgumentCache* scFastArgumentCache;
+	std::atomic<uint64_t>* tieredNextId;
+
+	// outputs can point at the compilers own buffers (owner set), otherwise shader is always a plain allocation
+	bool zeroCopyOutputs;
 
 	ShaderCompiler_IncludeCallback includeCallback;
+	ShaderCompiler_IncludeLoader includeLoader;
+	void* includeLoaderUserData;
+	ShaderCompiler::IncludeCache* includeCache;
+
+	// define sets in use with this context, defines is the context wide one (never holds null)
+	ShaderCompiler::DefinesTable* definesTable;
+	ShaderCompiler::DefinesPtr* defines;
+
+	ShaderCompiler::OutputCache* cache;
+	ShaderCompiler::DiskCache* diskCache;
+	uint64_t diskCacheBudget;
+	// compiles that are running, identical ones wait for them
+	ShaderCompiler::SingleFlight* inFlight;
+
+	// largest DXC high water mark of any compile with this context
+	std::atomic<uint64_t>* dxcPeakCompileMemory;
+	// null unless tracing is on
+	ShaderCompiler::Tracer* tracer;
+	// null unless recording to a capture file
+	ShaderCompiler::CaptureWriter* capture;
+
+	// async compiles, the pool is created on first use
+	std::mutex* asyncMutex;
+	ShaderCompiler::ThreadPool* asyncPool;
+	uint32_t asyncThreadCount;
+	// one thread per hardware thread for work the caller waits on (the parts of a multi target compile),
+	// created on first use (under asyncMutex) and kept until the context is destroyed
+	ShaderCompiler::ThreadPool* workPool;
 #if defined(SUPPORT_GLSL)
 	// khronos settings
 	shaderc_compiler_t khrCompiler;
 	shaderc_compile_options_t khrOptions;
 	shaderc_spvc_compiler_t khrSpvcCompiler;
 	shaderc_spvc_compile_options_t khrSpvcOptions;
+	// spvc options are changed per compile so the khronos path is one at a time
+	std::mutex* khrMutex;
 #endif
 } ShaderCompiler_Context;
 
+// the settings a compile uses, a copy so a compile that runs later (the optimised half of a tiered compile)
+// uses the settings it was started with whatever the Set* calls do meanwhile
+struct CompileSettings {
+	ShaderCompiler_Language inputLanguage;
+	ShaderCompiler_OutputType outputType;
+	uint32_t outputVersion;
+	ShaderCompiler_Optimizations optimizationLevel;
+	ShaderConductor::Compiler::Options scOptions;
+	ShaderConductor::Compiler::TargetDesc scTarget;
+	// the tiered fast options (ShaderConductor only) rather than the contexts
+	bool fastTier;
+};
+
+static CompileSettings CurrentSettings(ShaderCompiler_Context *ctx, bool fastTier) {
+	CompileSettings settings;
+	settings.inputLanguage = ctx->inputLanguage;
+	settings.outputType = ctx->outputType;
+	settings.outputVersion = ctx->outputVersion;
+	settings.optimizationLevel = fastTier ? ShaderCompiler_OPT_None : ctx->optimizationLevel;
+	settings.scOptions = fastTier ? ctx->scFastOptions : ctx->scOptions;
+	settings.scTarget = ctx->scTarget;
+	settings.fastTier = fastTier;
+	return settings;
+}
+
+static ShaderCompiler::ThreadPool *AsyncPool(ShaderCompiler_Context *ctx) {
+	std::lock_guard<std::mutex> lock(*ctx->asyncMutex);
+	if (!ctx->asyncPool) {
+		ctx->asyncPool = new ShaderCompiler::ThreadPool(ctx->asyncThreadCount);
+	}
+	return ctx->asyncPool;
+}
+
+static ShaderCompiler::ThreadPool *WorkPool(ShaderCompiler_Context *ctx) {
+	std::lock_guard<std::mutex> lock(*ctx->asyncMutex);
+	if (!ctx->workPool) {
+		ctx->workPool = new ShaderCompiler::ThreadPool(0);
+	}
+	return ctx->workPool;
+}
+
+// waits for the async work to finish. The pool is joined without asyncMutex held as the tasks it is
+// finishing can call AsyncPool (tiered compiles queue their optimised half), those go to a new pool
+// which is finished as well
+static void StopAsyncPool(ShaderCompiler_Context *ctx) {
+	while (true) {
+		ShaderCompiler::ThreadPool *pool;
+		{
+			std::lock_guard<std::mutex> lock(*ctx->asyncMutex);
+			pool = ctx->asyncPool;
+			ctx->asyncPool = nullptr;
+		}
+		if (!pool) return;
+		delete pool;
+	}
+}
+
+static void ScPrebuildArguments(ShaderCompiler_Context *ctx) {
+	if (ctx->scFastArgumentCache) {
+		ctx->scFastOptions = ctx->scOptions;
+		ScOptimizationConverter(ShaderCompiler_OPT_None, ctx->scFastOptions);
+		ctx->scFastOptions.argumentCache = ctx->scFastArgumentCache;
+	}
+	try {
+		ShaderConductor::PrebuildArguments(ctx->scArgumentCache, ctx->scOptions, ctx->scTarget.language);
+		if (ctx->scFastArgumentCache) {
+			ShaderConductor::PrebuildArguments(ctx->scFastArgumentCache, ctx->scFastOptions, ctx->scTarget.language);
+		}
+	} catch (std::exception const &e) {
+		// invalid option combinations are reported again by the compile that uses them
+		LOGERROR(e.what());
+	}
+}
+
 #if defined(SUPPORT_GLSL)
 static bool CompileShaderKhronos(
 		ShaderCompiler_Context *ctx,
@@ -150,10 +329,24 @@ static bool CompileShaderKhronos(
 		char const *name,
 		char const *entryPoint,
 		char const *src,
+		ShaderCompiler::Defines const *defines,
 		ShaderCompiler_Output *output
 ) {
 	// there are two phases, HLSL/GLSL to SPIRV then SPIRV -> HLSL, MSL, GLSL
 	memset(output, 0, sizeof(ShaderCompiler_Output));
+	std::lock_guard<std::mutex> lock(*ctx->khrMutex);
+
+	// shaderc takes defines as options so they go on a per compile copy
+	shaderc_compile_options_t options = ctx->khrOptions;
+	if (defines->Count()) {
+		options = shaderc_compile_options_clone(ctx->khrOptions);
+		for (uint32_t i = 0; i < defines->Count(); ++i) {
+			char const *value = defines->Value(i);
+			shaderc_compile_options_add_macro_definition(options,
+																									 defines->Name(i), strlen(defines->Name(i)),
+																									 value, value ? strlen(value) : 0);
+		}
+	}
 
 	shaderc_shader_kind kind = KhrTypeConverter(shaderType);
 	shaderc_compilation_result_t result = shaderc_compile_into_spv(ctx->khrCompiler,
@@ -162,7 +355,10 @@ static bool CompileShaderKhronos(
 																																 kind,
 																																 name,
 																																 entryPoint,
-																																 ctx->khrOptions);
+																																 options);
+	if (options != ctx->khrOptions) {
+		shaderc_compile_options_release(options);
+	}
 
 	if (shaderc_result_get_compilation_status(result) != shaderc_compilation_status_success) {
 		// don't work return error message
@@ -245,62 +441,363 @@ public:
 		uint32_t size;
 };
 
+// include memory owned by the user, given back via release when the blob goes
+class UserIncludeBlob : public ShaderConductor::Blob
+{
+public:
+		explicit UserIncludeBlob(ShaderCompiler_IncludeData const& include) : include(include) {}
+
+		virtual ~UserIncludeBlob() {
+			if (include.release) include.release(include.owner);
+		}
+
+		void const * Data() const {
+			return include.data;
+		}
+
+		uint32_t Size() const {
+			return (uint32_t) include.size;
+		}
+
+		ShaderCompiler_IncludeData include;
+};
+
+// loads an include via the user loader or callback, or from disk if there isn't one
+static ShaderConductor::Blob* LoadIncludeBlob(ShaderCompiler_Context *ctx, char const *includeName) {
+	if(ctx->includeLoader) {
+		ShaderCompiler_IncludeData include{};
+		if (ctx->includeLoader(ctx->includeLoaderUserData, includeName, &include)) {
+			return new UserIncludeBlob(include);
+		}
+		return nullptr;
+	}
+	if(ctx->includeCallback) {
+		char *out = nullptr;
+		bool okay = ctx->includeCallback(includeName, &out);
+		if (okay && out) {
+			OurBlob *blob = new OurBlob();
+			blob->ptr = out;
+			blob->size = utf8size(out);
+			return blob;
+		}
+		return nullptr;
+	}
+
+	// DXC asks for each include at several paths, most don't exist so missing isn't an exception
+	return ShaderConductor::TryLoadIncludeFile(includeName);
+}
+
+// the include cache's loader, when capturing every load is recorded so a replay sees the same contents
+static ShaderConductor::Blob* LoadInclude(void *user, char const *includeName) {
+	auto ctx = (ShaderCompiler_Context *) user;
+	ShaderConductor::Blob *blob = LoadIncludeBlob(ctx, includeName);
+	if (blob && ctx->capture) ctx->capture->Include(includeName, blob->Data(), blob->Size());
+	return blob;
+}
+
+// includes are loaded once per context, the loader or callback isn't called again until they are invalidated.
+// from disk nobody invalidates, so each use checks the file is unchanged and a miss looks again
+static ShaderCompiler::IncludeFilePtr CachedInclude(ShaderCompiler_Context *ctx, char const *includeName) {
+	bool const fromDisk = !ctx->includeLoader && !ctx->includeCallback;
+	return ctx->includeCache->Get(includeName, &LoadInclude, ctx, fromDisk);
+}
+
+// true if the include still has the contents it had when a cache entry was made (or is still missing)
+static bool ValidateCachedInclude(void *user, ShaderCompiler::IncludeDependency const& include) {
+	auto ctx = (ShaderCompiler_Context *) user;
+	ShaderCompiler::IncludeFilePtr file = CachedInclude(ctx, include.name.c_str());
+	if (include.contentHash == ShaderCompiler::MissingInclude) return !file;
+	return file && file->contentHash == include.contentHash;
+}
+
+static ShaderCompiler::Hash128 CacheKey(ShaderCompiler_Language inputLanguage,
+																				ShaderCompiler_OutputType outputType,
+																				ShaderConductor::Compiler::Options const& options,
+																				ShaderConductor::Compiler::TargetDesc const& target,
+																				ShaderCompiler_ShaderType shaderType,
+																				char const *name,
+																				char const *entryPoint,
+																				char const *src,
+																				ShaderCompiler::Defines const *defines) {
+	ShaderCompiler::Hasher hasher;
+	// bump when anything changes that makes old (on disk) entries invalid
+	hasher.AddValue((uint32_t)2);
+	hasher.AddString(src);
+	hasher.AddString(name);
+	hasher.AddString(entryPoint);
+	hasher.AddHash(defines->hash);
+	hasher.AddValue(shaderType);
+	hasher.AddValue(inputLanguage);
+	hasher.AddValue(outputType);
+	// the include callback isn't part of the key (so it stays stable between processes),
+	// includes are checked against their content when an entry is looked up
+
+	hasher.AddValue(options.packMatricesInRowMajor);
+	hasher.AddValue(options.enable16bitTypes);
+	hasher.AddValue(options.enableDebugInfo);
+	hasher.AddValue(options.disableOptimizations);
+	hasher.AddValue(options.optimizationLevel);
+	hasher.AddValue(options.shaderModel.FullVersion());
+
+	hasher.AddValue(target.language);
+	hasher.AddString(target.version);
+	return hasher.Finish();
+}
+
+// a cached result for the caller, only shared rather than copied if the context hands out zero copy outputs
+static void EntryToOutput(ShaderCompiler_Context *ctx,
+													ShaderCompiler::OutputCache::EntryPtr const& entry,
+													ShaderCompiler_Output *output) {
+	if (ctx->zeroCopyOutputs) {
+		ShaderCompiler::CachedOutput::ShareTo(entry, output);
+	} else {
+		entry->CopyTo(output);
+	}
+}
+
+// memory then disk cache, fills output and succeeded (if it was a cached failure) on a hit
+static bool CacheLookup(ShaderCompiler_Context *ctx,
+												ShaderCompiler::Hash128 const& key,
+												ShaderCompiler_Output *output,
+												bool *succeeded) {
+	ShaderCompiler::OutputCache::EntryPtr entry = ctx->cache->Lookup(key, &ValidateCachedInclude, ctx);
+	if (!entry && ctx->diskCache) {
+		entry = ctx->diskCache->Load(key, &ValidateCachedInclude, ctx);
+		if (entry) ctx->cache->Insert(key, entry);
+	}
+	if (!entry) return false;
+
+	// a shared output keeps the entry, evicting it only drops the caches reference
+	EntryToOutput(ctx, entry, output);
+	*succeeded = entry->succeeded;
+	return true;
+}
+
+// only failures the compiler explained are kept, anything else (an exception, DXC missing) may not happen again
+static bool Cacheable(bool succeeded, ShaderCompiler_Output const *output) {
+	return succeeded || output->log != nullptr;
+}
+
+static ShaderCompiler::OutputCache::EntryPtr CacheStore(ShaderCompiler_Context *ctx,
+																											 ShaderCompiler::Hash128 const& key,
+																											 ShaderCompiler_Output const *output,
+																											 bool succeeded,
+																											 std::vector<ShaderCompiler::IncludeDependency> includes) {
+	auto entry = ShaderCompiler::CachedOutput::From(output, succeeded, std::move(includes));
+	ctx->cache->Insert(key, entry);
+	if (ctx->diskCache) {
+		ctx->diskCache->Store(key, *entry);
+	}
+	return entry;
+}
+
+static void RecordDxcPeakMemory(ShaderCompiler_Context *ctx, uint64_t peak) {
+	uint64_t current = ctx->dxcPeakCompileMemory->load(std::memory_order_relaxed);
+	while (peak > current && !ctx->dxcPeakCompileMemory->compare_exchange_weak(current, peak)) {
+	}
+}
+
+static bool ScResultToOutput(ShaderConductor::Compiler::ResultDesc& result, ShaderCompiler_Output *output, bool zeroCopy) {
+	using namespace ShaderConductor;
+
+	if (result.errorWarningMsg != nullptr) {
+		output->log = CopyString((char *) result.errorWarningMsg->Data(), result.errorWarningMsg->Size());
+		DestroyBlob(result.errorWarningMsg);
+		result.errorWarningMsg = nullptr;
+	}
+	if (result.hasError || result.target == nullptr) {
+		DestroyBlob(result.target);
+		result.target = nullptr;
+		return false;
+	}
+
+	// text is already 0 terminated, the terminator is counted in the size
+	size_t const size = result.target->Size() + (result.isText ? 1 : 0);
+	if (zeroCopy) {
+		// the output takes over the blob
+		output->shader = result.target->Data();
+		output->owner = result.target;
+	} else {
+		output->shader = MEMORY_MALLOC(size);
+		memcpy((void *) output->shader, result.target->Data(), size);
+		DestroyBlob(result.target);
+	}
+	output->shaderSize = size;
+	result.target = nullptr;
+	return true;
+}
+
+static char const *PhaseName(ShaderConductor::Compiler::Phase phase) {
+	switch (phase) {
+	case ShaderConductor::Compiler::Phase::AcquireCompiler: return "acquire dxc";
+	case ShaderConductor::Compiler::Phase::FrontEnd: return "dxc compile";
+	case ShaderConductor::Compiler::Phase::Preprocess: return "dxc preprocess";
+	case ShaderConductor::Compiler::Phase::SpirvParse: return "spirv parse";
+	case ShaderConductor::Compiler::Phase::Conversion: return "convert binary";
+	}
+	return "unknown";
+}
+
+// compiles to all targets sharing a single front end pass, true if every target succeeded.
+// timings and dxcPeakMemory can be null, timings are added to not overwritten
 static bool CompileShaderShaderConductor(
 		ShaderCompiler_Context *ctx,
 		ShaderCompiler_ShaderType shaderType,
 		char const *name,
 		char const *entryPoint,
 		char const *src,
-		ShaderCompiler_Output *output
+		ShaderCompiler::Defines const *defines,
+		ShaderConductor::Compiler::Options const& options,
+		ShaderConductor::Compiler::TargetDesc const *targets,
+		uint32_t numTargets,
+		std::vector<ShaderCompiler::IncludeDependency> *includes,
+		ShaderCompiler_Timings *timings,
+		uint64_t *dxcPeakMemory,
+		ShaderCompiler_Output *outputs
 ) {
 	using namespace ShaderConductor;
-	memset(output, 0, sizeof(ShaderCompiler_Output));
+	memset(outputs, 0, sizeof(ShaderCompiler_Output) * numTargets);
 
 	Compiler::SourceDesc source{};
 	source.fileName = name;
 	source.source = src;
 	source.stage = SCShaderStageConvertor(shaderType);
 	source.entryPoint = entryPoint;
-	source.numDefines = 0; // TODO
-	if(ctx->includeCallback) {
-		source.loadIncludeCallback = [ctx](const char *includeName) -> Blob * {
-			char *out = nullptr;
-			bool okay = ctx->includeCallback(includeName, &out);
-			if (okay && out) {
-				OurBlob *blob = new OurBlob();
-				blob->ptr = out;
-				blob->size = utf8size(out);
-				return blob;
+	source.defineSet = defines->scDefineSet.get();
+	// DXIL and SPIRV front ends can run concurrently when both are targets and text conversions in parallel,
+	// so both callbacks can be called from several threads
+	std::mutex detailsMutex;
+	ShaderCompiler::Tracer *tracer = ctx->tracer;
+	source.loadIncludeCallback = [ctx, includes, timings, tracer, &detailsMutex](const char *includeName) -> Blob * {
+		uint64_t const begin = (timings || tracer) ? ShaderCompiler::NowNs() : 0;
+		ShaderCompiler::IncludeFilePtr file = CachedInclude(ctx, includeName);
+		if (timings || tracer) {
+			uint64_t const end = ShaderCompiler::NowNs();
+			if (tracer) tracer->Record("include load", includeName, begin, end);
+			if (timings) {
+				std::lock_guard<std::mutex> lock(detailsMutex);
+				timings->includes += end - begin;
+			}
+		}
+		if (includes) {
+			std::lock_guard<std::mutex> lock(detailsMutex);
+			includes->push_back({includeName, file ? file->contentHash : ShaderCompiler::MissingInclude});
+		}
+		if (!file) return nullptr;
+		return new ShaderCompiler::IncludeFileBlob(std::move(file));
+	};
+	if (timings || tracer) {
+		source.phaseCallback = [timings, tracer, name, &detailsMutex](Compiler::Phase phase, uint64_t beginNs, uint64_t endNs) {
+			if (tracer) tracer->Record(PhaseName(phase), name, beginNs, endNs);
+			if (!timings) return;
+			std::lock_guard<std::mutex> lock(detailsMutex);
+			switch (phase) {
+			case Compiler::Phase::FrontEnd: timings->frontEnd += endNs - beginNs; break;
+			case Compiler::Phase::SpirvParse: timings->spirvParse += endNs - beginNs; break;
+			case Compiler::Phase::Conversion: timings->conversion += endNs - beginNs; break;
+			default: break;
 			}
-			return nullptr;
 		};
 	}
 
+	// the parts of a multi target compile run on the work pool. Async and batch compiles are already on a pool
+	// worker and every worker has a compile of its own, so there they run one after another on that worker
+	if (numTargets > 1 && !ShaderCompiler::ThreadPool::OnWorkerThread()) {
+		ShaderCompiler::ThreadPool *pool = WorkPool(ctx);
+		source.parallelFor = [pool](uint32_t count, std::function<void(uint32_t)> const& fn) {
+			pool->ParallelFor(count, fn);
+		};
+	}
+
+	std::vector<Compiler::ResultDesc> results(numTargets);
 	try {
-		auto result = Compiler::Compile(source, ctx->scOptions, ctx->scTarget);
+		Compiler::Compile(source, options, targets, numTargets, results.data());
+	} catch (std::exception const &e) {
+		LOGERROR(e.what());
+		return false;
+	}
 
-		if (result.hasError) {
-			output->log = CopyString((char *) result.errorWarningMsg->Data(), result.errorWarningMsg->Size());
-			DestroyBlob(result.errorWarningMsg);
-			return false;
-		}
-		if (result.errorWarningMsg != nullptr) {
-			output->log = CopyString((char *) result.errorWarningMsg->Data(), result.errorWarningMsg->Size());
-			DestroyBlob(result.errorWarningMsg);
+	ShaderCompiler::TraceScope trace(tracer, "output", name);
+	bool ret = true;
+	for (uint32_t i = 0; i < numTargets; ++i) {
+		RecordDxcPeakMemory(ctx, results[i].dxcPeakMemory);
+		if (dxcPeakMemory && results[i].dxcPeakMemory > *dxcPeakMemory) {
+			*dxcPeakMemory = results[i].dxcPeakMemory;
 		}
+		ret = ScResultToOutput(results[i], &outputs[i], ctx->zeroCopyOutputs) && ret;
+	}
+	return ret;
+}
 
-		size_t const size = result.target->Size() + (result.isText ? 1 : 0);
-		output->shader = MEMORY_MALLOC(size);
-		memcpy((void *) output->shader, result.target->Data(), size);
-		if(result.isText) ((char*)output->shader)[size-1] = 0;
+// hash of the source after preprocessing with the given defines, false if it doesn't preprocess
+static bool PreprocessedHash(
+		ShaderCompiler_Context *ctx,
+		CompileSettings const& settings,
+		ShaderCompiler_ShaderType shaderType,
+		char const *name,
+		char const *entryPoint,
+		char const *src,
+		ShaderCompiler::Defines const *defines,
+		ShaderCompiler::Hash128 *hash
+) {
+	using namespace ShaderConductor;
 
-		output->shaderSize = size;
+	Compiler::SourceDesc source{};
+	source.fileName = name;
+	source.source = src;
+	source.stage = SCShaderStageConvertor(shaderType);
+	source.entryPoint = entryPoint;
+	source.defineSet = defines->scDefineSet.get();
+	source.loadIncludeCallback = [ctx](const char *includeName) -> Blob * {
+		ShaderCompiler::TraceScope trace(ctx->tracer, "include load", includeName);
+		ShaderCompiler::IncludeFilePtr file = CachedInclude(ctx, includeName);
+		return file ? new ShaderCompiler::IncludeFileBlob(std::move(file)) : nullptr;
+	};
+	if (ctx->tracer) {
+		ShaderCompiler::Tracer *tracer = ctx->tracer;
+		source.phaseCallback = [tracer, name](Compiler::Phase phase, uint64_t beginNs, uint64_t endNs) {
+			tracer->Record(PhaseName(phase), name, beginNs, endNs);
+		};
+	}
 
-		DestroyBlob(result.target);
+	Compiler::ResultDesc result;
+	try {
+		result = Compiler::Preprocess(source, settings.scOptions, settings.scTarget.language);
 	} catch (std::exception const &e) {
 		LOGERROR(e.what());
+		return false;
+	}
+
+	bool const ret = !result.hasError && result.target;
+	if (ret) {
+		*hash = ShaderCompiler::Hasher::Of(result.target->Data(), result.target->Size());
+	}
+	DestroyBlob(result.target);
+	DestroyBlob(result.errorWarningMsg);
+	return ret;
+}
+
+// memory files are used in place, anything else is read into a temp buffer. Files on disk are read rather than
+// mapped, a mapping can't be tied to the VFile's own handle and would fault if the file was cut short mid compile
+static char const *ReadSource(VFile_Handle file) {
+	if(VFile_GetType(file) == VFile_Type_Memory) {
+		auto memFile = (VFile_MemFile_t*) VFile_GetTypeSpecificData(file);
+		return ((char*) memFile->memory) + memFile->offset;
+	}
+
+	size_t const fileSize = VFile_Size(file);
+	if (fileSize == 0)
+		return nullptr;
+	char *src = (char *) MEMORY_TEMP_MALLOC(fileSize + 1);
+	size_t const read = VFile_Read(file, src, fileSize);
+	src[read] = 0;
+	return src;
+}
+
+static void FreeSource(VFile_Handle file, char const *src) {
+	if(VFile_GetType(file) != VFile_Type_Memory) {
+		MEMORY_TEMP_FREE((void *) src);
 	}
-	return true;
 }
 
 AL2O3_EXTERN_C ShaderCompiler_ContextHandle ShaderCompiler_Create() {
@@ -309,11 +806,23 @@ AL2O3_EXTERN_C ShaderCompiler_ContextHandle ShaderCompiler_Create() {
 
 	ctx->scOptions = ShaderConductor::Compiler::Options{};
 	ctx->scTarget = ShaderConductor::Compiler::TargetDesc{};
+	ctx->scArgumentCache = ShaderConductor::CreateArgumentCache();
+	ctx->scOptions.argumentCache = ctx->scArgumentCache;
+	ctx->includeCache = new ShaderCompiler::IncludeCache();
+	ctx->definesTable = new ShaderCompiler::DefinesTable();
+	ctx->defines = new ShaderCompiler::DefinesPtr(ctx->definesTable->Intern(nullptr, nullptr, 0));
+	ctx->cache = new ShaderCompiler::OutputCache(64 * 1024 * 1024);
+	ctx->diskCacheBudget = 1024 * 1024 * 1024;
+	ctx->inFlight = new ShaderCompiler::SingleFlight();
+	ctx->asyncMutex = new std::mutex();
+	ctx->dxcPeakCompileMemory = new std::atomic<uint64_t>(0);
+	ctx->tieredNextId = new std::atomic<uint64_t>(0);
 #if defined(SUPPORT_GLSL)
 	ctx->khrCompiler = shaderc_compiler_initialize();
 	ctx->khrOptions = shaderc_compile_options_initialize();
 	ctx->khrSpvcCompiler = shaderc_spvc_compiler_initialize();
 	ctx->khrSpvcOptions = shaderc_spvc_compile_options_initialize();
+	ctx->khrMutex = new std::mutex();
 
 
 	// 'debug' info is also needed for reflection
@@ -342,12 +851,32 @@ AL2O3_EXTERN_C void ShaderCompiler_Destroy(ShaderCompiler_ContextHandle handle)
 	auto ctx = (ShaderCompiler_Context *) handle;
 	if (!ctx) return;
 
+	// finishes any outstanding async work before anything it uses goes away
+	StopAsyncPool(ctx);
+	delete ctx->workPool;
+	delete ctx->asyncMutex;
+	delete ctx->dxcPeakCompileMemory;
+	delete ctx->tieredNextId;
+	delete ctx->tracer;
+	delete ctx->capture;
+
 #if defined(SUPPORT_GLSL)
 	shaderc_spvc_compile_options_release(ctx->khrSpvcOptions);
 	shaderc_spvc_compiler_release(ctx->khrSpvcCompiler);
 	shaderc_compile_options_release(ctx->khrOptions);
 	shaderc_compiler_release(ctx->khrCompiler);
+	delete ctx->khrMutex;
 #endif
+	delete ctx->inFlight;
+	delete ctx->diskCache;
+	delete ctx->cache;
+	delete ctx->defines;
+	delete ctx->definesTable;
+	delete ctx->includeCache;
+	if (ctx->scFastArgumentCache) {
+		ShaderConductor::DestroyArgumentCache(ctx->scFastArgumentCache);
+	}
+	ShaderConductor::DestroyArgumentCache(ctx->scArgumentCache);
 	MEMORY_FREE(ctx);
 }
 
@@ -370,12 +899,13 @@ AL2O3_EXTERN_C void ShaderCompiler_SetOutput(ShaderCompiler_ContextHandle handle
 	if (!ctx) return;
 
 	ctx->outputType = output;
+	ctx->outputVersion = outputVersion;
+	ScTargetConverter(output, outputVersion, ctx->scTarget, ctx->scOptions);
 
+#if defined(SUPPORT_GLSL)
 	switch (output) {
 	case ShaderCompiler_OT_SPIRV:
-		ctx->scTarget.language = ShaderConductor::ShadingLanguage::SpirV;
 		if(outputVersion == 0) outputVersion = 11;
-#if defined(SUPPORT_GLSL)
 		switch (outputVersion) {
 		case 10: shaderc_compile_options_set_target_spirv(ctx->khrOptions, shaderc_spirv_version_1_0);
 			break;
@@ -389,49 +919,15 @@ AL2O3_EXTERN_C void ShaderCompiler_SetOutput(ShaderCompiler_ContextHandle handle
 			break;
 			default: LOGERROR("Unsupported SPIRV output version", outputVersion);
 		}
-#endif
-		break;
-	case ShaderCompiler_OT_DXIL:
-		if(outputVersion == 0) outputVersion = 60;
-		ctx->scTarget.language = ShaderConductor::ShadingLanguage::Dxil;
-		ctx->scOptions.shaderModel.major_ver = (outputVersion / 10);
-		ctx->scOptions.shaderModel.minor_ver = (outputVersion % 10);
 		break;
 	case ShaderCompiler_OT_HLSL:
 		if(outputVersion == 0) outputVersion = 60;
-		ctx->scTarget.language  = ShaderConductor::ShadingLanguage::Hlsl;
-#if defined(SUPPORT_GLSL)
 		shaderc_spvc_compile_options_set_hlsl_shader_model(ctx->khrSpvcOptions, outputVersion);
-#endif
-		ctx->scOptions.shaderModel.major_ver = (outputVersion / 10);
-		ctx->scOptions.shaderModel.minor_ver = (outputVersion % 10);
-		break;
-
-	case ShaderCompiler_OT_GLSL:
-		if(outputVersion == 0) outputVersion = 450;
-
-		ctx->scTarget.language = ShaderConductor::ShadingLanguage::Glsl;
-		switch (outputVersion) {
-		case 300: ctx->scTarget.version = "300";
-			break;
-		case 400: ctx->scTarget.version = "400";
-			break;
-		default:
-		case 450: ctx->scTarget.version = "450";
-			break;
-		}
-		break;
 		break;
-	case ShaderCompiler_OT_MSL_OSX:
-		ctx->scTarget.language = ShaderConductor::ShadingLanguage::Msl_macOS;
-		ctx->scTarget.version = "20";
-		break;
-	case ShaderCompiler_OT_MSL_IOS:
-		ctx->scTarget.language = ShaderConductor::ShadingLanguage::Msl_iOS;
-			ctx->scTarget.version = "20";
-		break;
-
+	default: break;
 	}
+#endif
+	ScPrebuildArguments(ctx);
 }
 
 AL2O3_EXTERN_C void ShaderCompiler_SetOptimizationLevel(ShaderCompiler_ContextHandle handle,
@@ -444,68 +940,628 @@ AL2O3_EXTERN_C void ShaderCompiler_SetOptimizationLevel(ShaderCompiler_ContextHa
 	shaderc_compile_options_set_optimization_level(ctx->khrOptions, khropti);
 #endif
 	ScOptimizationConverter(level, ctx->scOptions);
+	ctx->optimizationLevel = level;
+	ScPrebuildArguments(ctx);
+}
 
+// writes a finished compile to the capture file, defines are the merged set so a replay needs no context defines
+static void RecordCompile(ShaderCompiler_Context *ctx,
+													 CompileSettings const& settings,
+													 ShaderCompiler_ShaderType type,
+													 char const *name,
+													 char const *entryPoint,
+													 char const *src,
+													 ShaderCompiler::Defines const *defines,
+													 uint64_t durationNs,
+													 bool succeeded) {
+	ShaderCompiler::CaptureCompile compile;
+	compile.source = ShaderCompiler::Hasher::Of(src, strlen(src));
+	compile.shaderType = (uint32_t) type;
+	compile.inputLanguage = (uint32_t) settings.inputLanguage;
+	compile.outputType = (uint32_t) settings.outputType;
+	compile.outputVersion = settings.outputVersion;
+	compile.optimizationLevel = (uint32_t) settings.optimizationLevel;
+	compile.name = name ? name : "";
+	compile.entryPoint = entryPoint ? entryPoint : "";
+	compile.defines.resize(defines->Count());
+	for (uint32_t i = 0; i < defines->Count(); ++i) {
+		compile.defines[i] = {defines->names[i], defines->values[i], defines->hasValue[i]};
+	}
+	compile.durationNs = durationNs;
+	compile.succeeded = succeeded;
+	ctx->capture->Compile(compile, src);
 }
 
-AL2O3_EXTERN_C bool ShaderCompiler_Compile(
-		ShaderCompiler_ContextHandle handle,
+// the cache key doesn't cover include contents, compiles only share if they'd load the same includes
+static ShaderCompiler::Hash128 FlightKey(ShaderCompiler::Hash128 const& cacheKey, uint64_t includeGeneration) {
+	ShaderCompiler::Hasher hasher;
+	hasher.AddHash(cacheKey);
+	hasher.AddValue(includeGeneration);
+	return hasher.Finish();
+}
+
+// the compile of a cache miss, identical compiles running at the same time share one. The result is stored
+// under cacheKey if the cache is on. includeGeneration is the include cache's from before the lookup.
+// result can be null, otherwise it is set to a shared copy of the output if one was made (null if not)
+static bool CompileMiss(
+		ShaderCompiler_Context *ctx,
+		CompileSettings const& settings,
+		bool useShaderConductor,
+		ShaderCompiler::Hash128 const& cacheKey,
+		uint64_t includeGeneration,
 		ShaderCompiler_ShaderType type,
 		char const *name,
 		char const *entryPoint,
-		VFile_Handle file,
-		ShaderCompiler_Output *output
+		char const *src,
+		ShaderCompiler::Defines const *defines,
+		ShaderCompiler_Output *output,
+		ShaderCompiler_OutputEx *details,
+		ShaderCompiler::OutputCache::EntryPtr *result
 ) {
-	auto ctx = (ShaderCompiler_Context *) handle;
-	if (!ctx) return false;
+	ShaderCompiler_Timings *timings = details ? &details->timings : nullptr;
+	bool const useCache = ctx->cache->Enabled();
+	bool ret = false;
+
+	ShaderCompiler::Hash128 const flightKey = FlightKey(cacheKey, includeGeneration);
+
+	ShaderCompiler::OutputCache::EntryPtr shared;
+	bool sharedSucceeded = false;
+	uint64_t const waitBegin = ctx->tracer ? ShaderCompiler::NowNs() : 0;
+	if (ctx->inFlight->Wait(flightKey, shared, sharedSucceeded)) {
+		if (ctx->tracer) ctx->tracer->Record("wait in flight", name, waitBegin, ShaderCompiler::NowNs());
+		if (shared) {
+			EntryToOutput(ctx, shared, output);
+		} else {
+			// the compile we waited for threw
+			memset(output, 0, sizeof(ShaderCompiler_Output));
+		}
+		ret = sharedSucceeded;
+		if (details) details->coalesced = true;
+		if (result) *result = shared;
+	} else {
+		ShaderCompiler::SingleFlightLeader leader(*ctx->inFlight, flightKey);
+		std::vector<ShaderCompiler::IncludeDependency> includes;
+		if (useShaderConductor) {
+			ret = CompileShaderShaderConductor(ctx, type, name, entryPoint, src, defines,
+																				 settings.scOptions, &settings.scTarget, 1,
+																				 useCache ? &includes : nullptr,
+																				 timings, details ? &details->dxcPeakMemory : nullptr, output);
+		} else {
+#if defined(SUPPORT_GLSL)
+			ret = CompileShaderKhronos(ctx, type, name, entryPoint, src, defines, output);
+#endif
+		}
+		ShaderCompiler::OutputCache::EntryPtr entry;
+		if (useCache && Cacheable(ret, output)) {
+			ShaderCompiler::TraceScope storeTrace(ctx->tracer, "cache store", name);
+			ShaderCompiler::ScopedTime time(timings ? &timings->cache : nullptr);
+			entry = CacheStore(ctx, cacheKey, output, ret, std::move(includes));
+		}
+		// failures are shared too, whoever waited gets the same error log
+		leader.Finish(ret, [&entry, output, ret]() {
+			return entry ? entry : ShaderCompiler::CachedOutput::From(output, ret, {});
+		});
+		if (result) *result = entry;
+	}
+	return ret;
+}
 
+// details can be null, otherwise it is filled in with how the compile went (output can be details->output)
+static bool CompileSource(
+		ShaderCompiler_Context *ctx,
+		CompileSettings const& settings,
+		ShaderCompiler_ShaderType type,
+		char const *name,
+		char const *entryPoint,
+		char const *src,
+		ShaderCompiler::Defines const *defines,
+		ShaderCompiler_Output *output,
+		ShaderCompiler_OutputEx *details
+) {
 	bool useShaderConductor = true;
 
-	if (ctx->inputLanguage == ShaderCompiler_LANG_GLSL &&
-			ctx->outputType == ShaderCompiler_OT_DXIL) {
+	if (settings.inputLanguage == ShaderCompiler_LANG_GLSL &&
+			settings.outputType == ShaderCompiler_OT_DXIL) {
 		// currently DXIL and GLSL are not supported. In theory it could be but..
 		// TODO GLSL to DXIL via glslang->SpirvCross->hlsl->ShaderConductor->DXIL
 		return false;
 	}
 
-	if (ctx->inputLanguage == ShaderCompiler_LANG_GLSL) {
+	if (settings.inputLanguage == ShaderCompiler_LANG_GLSL) {
 #if defined(SUPPORT_GLSL)
 		useShaderConductor = false;
 #else
 		return false;
 #endif
 	}
-	if(ctx->outputType == ShaderCompiler_OT_DXIL) {
+	if(settings.outputType == ShaderCompiler_OT_DXIL) {
 		useShaderConductor = true;
 	}
 
+	ShaderCompiler::TraceScope trace(ctx->tracer, settings.fastTier ? "compile fast tier" : "compile", name);
+	uint64_t const captureBegin = ctx->capture ? ShaderCompiler::NowNs() : 0;
+	ShaderCompiler_Timings *timings = details ? &details->timings : nullptr;
+	bool const useCache = ctx->cache->Enabled();
+	// the includes this compile starts with
+	uint64_t const includeGeneration = ctx->includeCache->Generation();
+	ShaderCompiler::Hash128 const cacheKey = CacheKey(settings.inputLanguage, settings.outputType,
+																										settings.scOptions, settings.scTarget,
+																										type, name, entryPoint, src, defines);
+	bool ret = false;
+	bool hit = false;
+	if (useCache) {
+		ShaderCompiler::TraceScope lookupTrace(ctx->tracer, "cache lookup", name);
+		ShaderCompiler::ScopedTime time(timings ? &timings->cache : nullptr);
+		hit = CacheLookup(ctx, cacheKey, output, &ret);
+	}
+	if (details) details->cacheHit = hit;
 
-	char* src;
-	if(VFile_GetType(file) == VFile_Type_Memory) {
-		auto memFile = (VFile_MemFile_t*) VFile_GetTypeSpecificData(file);
-		src = ((char*) memFile->memory) + memFile->offset;
-	} else {
-		size_t const fileSize = VFile_Size(file);
-		if (fileSize == 0)
-			return false;
-		src = (char *) MEMORY_TEMP_MALLOC(fileSize + 1);
-		VFile_Read(file, src, fileSize);
-		src[fileSize] = 0;
+	if (!hit) {
+		ret = CompileMiss(ctx, settings, useShaderConductor, cacheKey, includeGeneration,
+											type, name, entryPoint, src, defines, output, details, nullptr);
 	}
+	if (ctx->capture) {
+		RecordCompile(ctx, settings, type, name, entryPoint, src, defines, ShaderCompiler::NowNs() - captureBegin, ret);
+	}
+	return ret;
+}
 
-	bool ret = false;
-	if (useShaderConductor) {
-		ret = CompileShaderShaderConductor(ctx, type, name, entryPoint, src, output);
-	} else {
-#if defined(SUPPORT_GLSL)
-		ret = CompileShaderKhronos(ctx, type, name, entryPoint, src, output);
-#endif
+// HLSL only, GLSL goes through khronos which has no second set of options
+static bool IsTiered(ShaderCompiler_Context *ctx) {
+	return ctx->tieredCallback &&
+			ctx->inputLanguage == ShaderCompiler_LANG_HLSL &&
+			ctx->optimizationLevel != ShaderCompiler_OPT_None;
+}
+
+// the optimised result if it is already cached, otherwise an unoptimised one now and the optimised one
+// to the tiered callback once a worker has compiled it
+static bool CompileTiered(
+		ShaderCompiler_Context *ctx,
+		ShaderCompiler_ShaderType type,
+		char const *name,
+		char const *entryPoint,
+		char const *src,
+		ShaderCompiler::DefinesPtr const& defines,
+		ShaderCompiler_Output *output,
+		ShaderCompiler_OutputEx *details
+) {
+	// the optimised half uses the settings as they are now, not when it gets to run
+	CompileSettings const optimisedSettings = CurrentSettings(ctx, false);
+	if (ctx->cache->Enabled()) {
+		bool ret = false;
+		ShaderCompiler::Hash128 const key = CacheKey(optimisedSettings.inputLanguage, optimisedSettings.outputType,
+																								 optimisedSettings.scOptions, optimisedSettings.scTarget,
+																								 type, name, entryPoint, src, defines.get());
+		if (CacheLookup(ctx, key, output, &ret)) {
+			if (details) details->cacheHit = true;
+			return ret;
+		}
 	}
-	if(VFile_GetType(file) != VFile_Type_Memory) {
-		MEMORY_TEMP_FREE(src);
+
+	bool const ret = CompileSource(ctx, CurrentSettings(ctx, true), type, name, entryPoint, src, defines.get(), output, details);
+	// a compile error won't go away with optimisation on, only retry failures with no log
+	if (!ret && output->log) return ret;
+
+	// the source is only valid for this call and the callback can change, the job keeps its own
+	uint64_t const id = ++(*ctx->tieredNextId);
+	if (details) details->tieredId = id;
+	std::string const nameCopy = name ? name : "";
+	std::string const entryPointCopy = entryPoint ? entryPoint : "";
+	std::string const srcCopy = src;
+	ShaderCompiler_TieredCallback const callback = ctx->tieredCallback;
+	void *userData = ctx->tieredUserData;
+	AsyncPool(ctx)->Submit([ctx, optimisedSettings, type, nameCopy, entryPointCopy, srcCopy, defines, callback, userData, id]() {
+		ShaderCompiler_Output optimised;
+		bool const ok = CompileSource(ctx, optimisedSettings, type, nameCopy.c_str(), entryPointCopy.c_str(),
+																	srcCopy.c_str(), defines.get(), &optimised, nullptr);
+		callback(userData, id, nameCopy.c_str(), entryPointCopy.c_str(), ok, &optimised);
+	});
+	return ret;
+}
+
+static bool CompileWithDefines(
+		ShaderCompiler_Context *ctx,
+		ShaderCompiler_ShaderType type,
+		char const *name,
+		char const *entryPoint,
+		VFile_Handle file,
+		ShaderCompiler::DefinesPtr const& defines,
+		ShaderCompiler_Output *output,
+		ShaderCompiler_OutputEx *details
+) {
+	uint64_t const begin = details ? ShaderCompiler::NowNs() : 0;
+
+	char const *src;
+	{
+		ShaderCompiler::TraceScope trace(ctx->tracer, "read source", name);
+		ShaderCompiler::ScopedTime time(details ? &details->timings.readSource : nullptr);
+		src = ReadSource(file);
+	}
+	if (!src) return false;
+
+	bool const ret = IsTiered(ctx) ?
+			CompileTiered(ctx, type, name, entryPoint, src, defines, output, details) :
+			CompileSource(ctx, CurrentSettings(ctx, false), type, name, entryPoint, src, defines.get(), output, details);
+	FreeSource(file, src);
+
+	if (details) details->timings.total = ShaderCompiler::NowNs() - begin;
+	return ret;
+}
+
+AL2O3_EXTERN_C bool ShaderCompiler_Compile(
+		ShaderCompiler_ContextHandle handle,
+		ShaderCompiler_ShaderType type,
+		char const *name,
+		char const *entryPoint,
+		VFile_Handle file,
+		ShaderCompiler_Output *output
+) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx) return false;
+
+	return CompileWithDefines(ctx, type, name, entryPoint, file, *ctx->defines, output, nullptr);
+}
+
+AL2O3_EXTERN_C bool ShaderCompiler_CompileWithDefines(
+		ShaderCompiler_ContextHandle handle,
+		ShaderCompiler_ShaderType type,
+		char const *name,
+		char const *entryPoint,
+		VFile_Handle file,
+		ShaderCompiler_Define const *defines,
+		uint32_t defineCount,
+		ShaderCompiler_Output *output
+) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx) return false;
+
+	ShaderCompiler::DefinesPtr const merged = ctx->definesTable->Intern(ctx->defines->get(), defines, defineCount);
+	return CompileWithDefines(ctx, type, name, entryPoint, file, merged, output, nullptr);
+}
+
+AL2O3_EXTERN_C bool ShaderCompiler_CompileEx(
+		ShaderCompiler_ContextHandle handle,
+		ShaderCompiler_ShaderType type,
+		char const *name,
+		char const *entryPoint,
+		VFile_Handle file,
+		ShaderCompiler_Define const *defines,
+		uint32_t defineCount,
+		ShaderCompiler_OutputEx *output
+) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx || !output) return false;
+	memset(output, 0, sizeof(ShaderCompiler_OutputEx));
+
+	ShaderCompiler::DefinesPtr const merged = ctx->definesTable->Intern(ctx->defines->get(), defines, defineCount);
+	return CompileWithDefines(ctx, type, name, entryPoint, file, merged, &output->output, output);
+}
+
+AL2O3_EXTERN_C bool ShaderCompiler_CompileMulti(
+		ShaderCompiler_ContextHandle handle,
+		ShaderCompiler_ShaderType type,
+		char const *name,
+		char const *entryPoint,
+		VFile_Handle file,
+		ShaderCompiler_Target const *targets,
+		uint32_t targetCount,
+		ShaderCompiler_Output *outputs
+) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx || !targets || !outputs || targetCount == 0) return false;
+	memset(outputs, 0, sizeof(ShaderCompiler_Output) * targetCount);
+
+	// the khronos path has no shared front end, multi target is shader conductor only
+	if (ctx->inputLanguage != ShaderCompiler_LANG_HLSL) return false;
+
+	// DXIL and HLSL targets use the shader model of their own version, the others take the first DXIL
+	// targets (or failing that the first HLSL targets) so they share its front end pass
+	ShaderConductor::Compiler::Options shared = ctx->scOptions;
+	for (ShaderCompiler_OutputType const modelType : {ShaderCompiler_OT_HLSL, ShaderCompiler_OT_DXIL}) {
+		for (uint32_t i = 0; i < targetCount; ++i) {
+			if (targets[i].outputType == modelType) {
+				ShaderConductor::Compiler::TargetDesc unused;
+				ScTargetConverter(targets[i].outputType, targets[i].outputVersion, unused, shared);
+				break;
+			}
+		}
+	}
+	std::vector<ShaderConductor::Compiler::Options> options(targetCount, shared);
+	std::vector<ShaderConductor::Compiler::TargetDesc> scTargets(targetCount);
+	for (uint32_t i = 0; i < targetCount; ++i) {
+		ScTargetConverter(targets[i].outputType, targets[i].outputVersion, scTargets[i], options[i]);
+	}
+
+	ShaderCompiler::TraceScope trace(ctx->tracer, "compile multi", name);
+	char const *src;
+	{
+		ShaderCompiler::TraceScope readTrace(ctx->tracer, "read source", name);
+		src = ReadSource(file);
+	}
+	if (!src) return false;
+
+	ShaderCompiler::DefinesPtr const defines = *ctx->defines;
+	bool const useCache = ctx->cache->Enabled();
+	// the includes this compile starts with
+	uint64_t const includeGeneration = ctx->includeCache->Generation();
+	uint64_t const captureBegin = ctx->capture ? ShaderCompiler::NowNs() : 0;
+
+	// what each target would be as a single compile, for its cache key and capture record
+	std::vector<CompileSettings> settings(targetCount, CurrentSettings(ctx, false));
+	std::vector<ShaderCompiler::Hash128> keys(targetCount);
+	std::vector<bool> results(targetCount, false);
+	std::vector<uint32_t> misses;
+	for (uint32_t i = 0; i < targetCount; ++i) {
+		settings[i].outputType = targets[i].outputType;
+		settings[i].outputVersion = targets[i].outputVersion;
+		settings[i].scOptions = options[i];
+		settings[i].scTarget = scTargets[i];
+		keys[i] = CacheKey(ctx->inputLanguage, targets[i].outputType, options[i], scTargets[i], type, name, entryPoint, src, defines.get());
+		if (useCache) {
+			bool succeeded;
+			if (CacheLookup(ctx, keys[i], &outputs[i], &succeeded)) {
+				results[i] = succeeded;
+				continue;
+			}
+		}
+		misses.push_back(i);
+	}
+
+	// a target already being compiled (by a single or multi compile) is waited for rather than compiled again.
+	// flights are joined in key order, so two multi compiles can't each wait on a target the other is leading
+	std::sort(misses.begin(), misses.end(), [&keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+	std::vector<std::unique_ptr<ShaderCompiler::SingleFlightLeader>> leaders(targetCount);
+	std::vector<uint32_t> compiles;
+	for (size_t j = 0; j < misses.size(); ++j) {
+		uint32_t const index = misses[j];
+		// the same target twice in this call, waiting would be waiting on ourselves
+		if (j > 0 && keys[misses[j - 1]] == keys[index] && leaders[misses[j - 1]]) {
+			compiles.push_back(index);
+			continue;
+		}
+		ShaderCompiler::Hash128 const flightKey = FlightKey(keys[index], includeGeneration);
+		ShaderCompiler::OutputCache::EntryPtr shared;
+		bool sharedSucceeded = false;
+		uint64_t const waitBegin = ctx->tracer ? ShaderCompiler::NowNs() : 0;
+		if (ctx->inFlight->Wait(flightKey, shared, sharedSucceeded)) {
+			if (ctx->tracer) ctx->tracer->Record("wait in flight", name, waitBegin, ShaderCompiler::NowNs());
+			if (shared) {
+				EntryToOutput(ctx, shared, &outputs[index]);
+			} else {
+				// the compile we waited for threw
+				memset(&outputs[index], 0, sizeof(ShaderCompiler_Output));
+			}
+			results[index] = sharedSucceeded;
+		} else {
+			leaders[index].reset(new ShaderCompiler::SingleFlightLeader(*ctx->inFlight, flightKey));
+			compiles.push_back(index);
+		}
+	}
+
+	// one front end pass per shader model the misses need
+	while (!compiles.empty()) {
+		uint32_t const model = options[compiles[0]].shaderModel.FullVersion();
+		std::vector<uint32_t> group;
+		std::vector<uint32_t> rest;
+		for (uint32_t const index : compiles) {
+			(options[index].shaderModel.FullVersion() == model ? group : rest).push_back(index);
+		}
+		compiles.swap(rest);
+
+		std::vector<ShaderConductor::Compiler::TargetDesc> groupTargets(group.size());
+		std::vector<ShaderCompiler_Output> groupOutputs(group.size());
+		for (size_t i = 0; i < group.size(); ++i) {
+			groupTargets[i] = scTargets[group[i]];
+		}
+
+		std::vector<ShaderCompiler::IncludeDependency> includes;
+		CompileShaderShaderConductor(ctx, type, name, entryPoint, src, defines.get(),
+																 options[group[0]], groupTargets.data(), (uint32_t) group.size(),
+																 useCache ? &includes : nullptr, nullptr, nullptr, groupOutputs.data());
+
+		for (size_t i = 0; i < group.size(); ++i) {
+			uint32_t const index = group[i];
+			ShaderCompiler_Output *output = &outputs[index];
+			*output = groupOutputs[i];
+			// each target's own outcome, a target with no shader failed
+			bool const succeeded = output->shader != nullptr;
+			results[index] = succeeded;
+			ShaderCompiler::OutputCache::EntryPtr entry;
+			if (useCache && Cacheable(succeeded, output)) {
+				entry = CacheStore(ctx, keys[index], output, succeeded, includes);
+			}
+			if (leaders[index]) {
+				leaders[index]->Finish(succeeded, [&entry, output, succeeded]() {
+					return entry ? entry : ShaderCompiler::CachedOutput::From(output, succeeded, {});
+				});
+			}
+		}
+	}
+
+	bool ret = true;
+	for (uint32_t i = 0; i < targetCount; ++i) {
+		if (ctx->capture) {
+			RecordCompile(ctx, settings[i], type, name, entryPoint, src, defines.get(), ShaderCompiler::NowNs() - captureBegin, results[i]);
+		}
+		ret = results[i] && ret;
 	}
+	FreeSource(file, src);
 
 	return ret;
 }
+AL2O3_EXTERN_C uint32_t ShaderCompiler_CompilePermutations(
+		ShaderCompiler_ContextHandle handle,
+		ShaderCompiler_ShaderType type,
+		char const *name,
+		char const *entryPoint,
+		VFile_Handle file,
+		ShaderCompiler_Permutation const *permutations,
+		uint32_t permutationCount,
+		ShaderCompiler_Output *outputs,
+		bool *succeeded
+) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx || !permutations || !outputs || permutationCount == 0) return 0;
+	memset(outputs, 0, sizeof(ShaderCompiler_Output) * permutationCount);
+
+	char const *src = ReadSource(file);
+	if (!src) return 0;
+
+	std::vector<ShaderCompiler::DefinesPtr> defines(permutationCount);
+	for (uint32_t i = 0; i < permutationCount; ++i) {
+		defines[i] = ctx->definesTable->Intern(ctx->defines->get(), permutations[i].defines, permutations[i].defineCount);
+	}
+
+	CompileSettings const settings = CurrentSettings(ctx, false);
+	std::vector<bool> results(permutationCount);
+	uint32_t succeededCount = 0;
+	if (settings.inputLanguage != ShaderCompiler_LANG_HLSL) {
+		// only HLSL is deduplicated
+		for (uint32_t i = 0; i < permutationCount; ++i) {
+			results[i] = CompileSource(ctx, settings, type, name, entryPoint, src, defines[i].get(), &outputs[i], nullptr);
+			if (succeeded) succeeded[i] = results[i];
+			if (results[i]) succeededCount++;
+		}
+		FreeSource(file, src);
+		return succeededCount;
+	}
+
+	// cached permutations need neither preprocessing nor a compile
+	bool const useCache = ctx->cache->Enabled();
+	uint64_t const includeGeneration = ctx->includeCache->Generation();
+	std::vector<ShaderCompiler::Hash128> keys(permutationCount);
+	std::vector<bool> hits(permutationCount);
+	for (uint32_t i = 0; i < permutationCount; ++i) {
+		keys[i] = CacheKey(settings.inputLanguage, settings.outputType, settings.scOptions, settings.scTarget,
+											 type, name, entryPoint, src, defines[i].get());
+		if (useCache) {
+			ShaderCompiler::TraceScope trace(ctx->tracer, "cache lookup", name);
+			uint64_t const begin = ctx->capture ? ShaderCompiler::NowNs() : 0;
+			bool ret = false;
+			hits[i] = CacheLookup(ctx, keys[i], &outputs[i], &ret);
+			results[i] = ret;
+			if (hits[i] && ctx->capture) {
+				RecordCompile(ctx, settings, type, name, entryPoint, src, defines[i].get(), ShaderCompiler::NowNs() - begin, ret);
+			}
+		}
+	}
+
+	// each other permutation maps to the first with the same preprocessed source, only those get compiled.
+	// a permutation that fails to preprocess is left on its own so the compile reports the error
+	std::vector<uint32_t> compiledAs(permutationCount);
+	std::unordered_map<ShaderCompiler::Hash128, uint32_t, ShaderCompiler::Hash128Hasher> unique;
+	for (uint32_t i = 0; i < permutationCount; ++i) {
+		compiledAs[i] = i;
+		ShaderCompiler::Hash128 hash;
+		if (!hits[i] && PreprocessedHash(ctx, settings, type, name, entryPoint, src, defines[i].get(), &hash)) {
+			compiledAs[i] = unique.emplace(hash, i).first->second;
+		}
+	}
+
+	// duplicates share the output of the one that was compiled rather than each getting a copy
+	std::vector<ShaderCompiler::OutputCache::EntryPtr> shared(permutationCount);
+	for (uint32_t i = 0; i < permutationCount; ++i) {
+		if (hits[i]) {
+			// outputs[i] is already filled in
+		} else if (compiledAs[i] == i) {
+			ShaderCompiler::TraceScope trace(ctx->tracer, "compile", name);
+			uint64_t const begin = ctx->capture ? ShaderCompiler::NowNs() : 0;
+			results[i] = CompileMiss(ctx, settings, true, keys[i], includeGeneration,
+															 type, name, entryPoint, src, defines[i].get(), &outputs[i], nullptr, &shared[i]);
+			if (ctx->capture) {
+				RecordCompile(ctx, settings, type, name, entryPoint, src, defines[i].get(), ShaderCompiler::NowNs() - begin, results[i]);
+			}
+		} else {
+			uint32_t const first = compiledAs[i];
+			if (!shared[first]) {
+				// not cached or shared, the one copy is made for all of its duplicates
+				shared[first] = ShaderCompiler::CachedOutput::From(&outputs[first], results[first], {});
+			}
+			EntryToOutput(ctx, shared[first], &outputs[i]);
+			results[i] = results[first];
+		}
+		if (succeeded) succeeded[i] = results[i];
+		if (results[i]) succeededCount++;
+	}
+	FreeSource(file, src);
+
+	return succeededCount;
+}
+
+AL2O3_EXTERN_C uint32_t ShaderCompiler_CompileBatch(
+		ShaderCompiler_ContextHandle handle,
+		ShaderCompiler_Job const *jobs,
+		uint32_t jobCount,
+		ShaderCompiler_Output *outputs,
+		bool *succeeded,
+		uint32_t threadCount
+) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx || !jobs || !outputs || jobCount == 0) return 0;
+	memset(outputs, 0, sizeof(ShaderCompiler_Output) * jobCount);
+
+	std::atomic<uint32_t> succeededCount(0);
+	auto compileJob = [&](uint32_t i) {
+		ShaderCompiler_Job const& job = jobs[i];
+		bool const ret = ShaderCompiler_Compile(ctx, job.type, job.name, job.entryPoint, job.file, &outputs[i]);
+		if (succeeded) succeeded[i] = ret;
+		if (ret) succeededCount++;
+	};
+
+	// the contexts pool is shared with multi target compiles, a batch from a pool task (which could be one of
+	// its own workers, ParallelFor would then wait on itself) or with a thread count of its own gets a pool
+	// just for this call
+	ShaderCompiler::ThreadPool *pool = WorkPool(ctx);
+	if (ShaderCompiler::ThreadPool::OnWorkerThread() || (threadCount != 0 && threadCount != pool->ThreadCount())) {
+		ShaderCompiler::ThreadPool callPool(threadCount);
+		callPool.ParallelFor(jobCount, compileJob);
+	} else {
+		pool->ParallelFor(jobCount, compileJob);
+	}
+
+	return succeededCount;
+}
+
+AL2O3_EXTERN_C void ShaderCompiler_SetAsyncThreadCount(ShaderCompiler_ContextHandle handle, uint32_t threadCount) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx) return;
+
+	{
+		std::lock_guard<std::mutex> lock(*ctx->asyncMutex);
+		ctx->asyncThreadCount = threadCount;
+	}
+	StopAsyncPool(ctx);
+}
+
+AL2O3_EXTERN_C ShaderCompiler_TicketHandle ShaderCompiler_CompileAsync(
+		ShaderCompiler_ContextHandle handle,
+		ShaderCompiler_ShaderType type,
+		char const *name,
+		char const *entryPoint,
+		VFile_Handle file,
+		ShaderCompiler_CompletionCallback callback,
+		void *userData
+) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx) return nullptr;
+
+	std::string const nameCopy = name ? name : "";
+	std::string const entryPointCopy = entryPoint ? entryPoint : "";
+	// defines are the ones set when the compile was queued, not when it runs
+	ShaderCompiler::DefinesPtr const defines = *ctx->defines;
+	return ShaderCompiler::SubmitAsync(*AsyncPool(ctx), [ctx, type, nameCopy, entryPointCopy, file, defines](ShaderCompiler_Output *output) {
+		return CompileWithDefines(ctx, type, nameCopy.c_str(), entryPointCopy.c_str(), file, defines, output, nullptr);
+	}, callback, userData);
+}
+
+AL2O3_EXTERN_C void ShaderCompiler_SetDefines(ShaderCompiler_ContextHandle handle,
+																							ShaderCompiler_Define const *defines,
+																							uint32_t defineCount) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx) return;
+	*ctx->defines = ctx->definesTable->Intern(nullptr, defines, defineCount);
+}
+
 AL2O3_EXTERN_C void ShaderCompiler_AddHeaderCallback(ShaderCompiler_ContextHandle sc, ShaderCompiler_IncludeCallback callback) {
 	ASSERT(sc);
 	if(callback && sc->includeCallback != nullptr) {
@@ -513,6 +1569,50 @@ AL2O3_EXTERN_C void ShaderCompiler_AddHeaderCallback(ShaderCompiler_ContextHandl
 		return;
 	}
 	sc->includeCallback = callback;
+	// anything loaded came from the old callback
+	sc->includeCache->Clear();
+}
+
+AL2O3_EXTERN_C void ShaderCompiler_SetIncludeLoader(ShaderCompiler_ContextHandle handle,
+																										ShaderCompiler_IncludeLoader loader,
+																										void *userData) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx) return;
+	ctx->includeLoader = loader;
+	ctx->includeLoaderUserData = userData;
+	ctx->includeCache->Clear();
+}
+
+AL2O3_EXTERN_C void ShaderCompiler_InvalidateInclude(ShaderCompiler_ContextHandle handle, char const *name) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx || !name) return;
+	ctx->includeCache->Invalidate(name);
+}
+
+AL2O3_EXTERN_C void ShaderCompiler_InvalidateAllIncludes(ShaderCompiler_ContextHandle handle) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx) return;
+	ctx->includeCache->Clear();
+}
+
+AL2O3_EXTERN_C void ShaderCompiler_SetZeroCopyOutputs(ShaderCompiler_ContextHandle handle, bool zeroCopy) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx) return;
+	ctx->zeroCopyOutputs = zeroCopy;
+}
+
+AL2O3_EXTERN_C void ShaderCompiler_FreeOutput(ShaderCompiler_Output *output) {
+	if (!output) return;
+
+	if (output->owner) {
+		ShaderConductor::DestroyBlob((ShaderConductor::Blob *) output->owner);
+	} else if (output->shader) {
+		MEMORY_FREE((void *) output->shader);
+	}
+	if (output->log) {
+		MEMORY_FREE((void *) output->log);
+	}
+	memset(output, 0, sizeof(ShaderCompiler_Output));
 }
 
 AL2O3_EXTERN_C bool ShaderCompiler_CompileShader(
@@ -539,4 +1639,99 @@ AL2O3_EXTERN_C bool ShaderCompiler_CompileShader(
 
 	ShaderCompiler_Destroy(ctx);
 	return ret;
-}
\ No newline at end of file
+}
+AL2O3_EXTERN_C void ShaderCompiler_SetCacheBudget(ShaderCompiler_ContextHandle handle, uint64_t budget) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx) return;
+	ctx->cache->SetBudget(budget);
+}
+
+AL2O3_EXTERN_C void ShaderCompiler_ClearCache(ShaderCompiler_ContextHandle handle) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx) return;
+	ctx->cache->Clear();
+	ctx->definesTable->Trim();
+}
+
+AL2O3_EXTERN_C void ShaderCompiler_GetCacheStats(ShaderCompiler_ContextHandle handle, ShaderCompiler_CacheStats *stats) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx || !stats) return;
+	ctx->cache->GetStats(stats);
+	stats->diskHits = ctx->diskCache ? ctx->diskCache->Hits() : 0;
+	stats->diskMisses = ctx->diskCache ? ctx->diskCache->Misses() : 0;
+}
+
+AL2O3_EXTERN_C void ShaderCompiler_GetMemoryStats(ShaderCompiler_ContextHandle handle, ShaderCompiler_MemoryStats *stats) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx || !stats) return;
+	stats->dxcLiveBytes = ShaderConductor::DxcLiveMemory();
+	stats->dxcPeakCompileBytes = ctx->dxcPeakCompileMemory->load(std::memory_order_relaxed);
+}
+
+AL2O3_EXTERN_C void ShaderCompiler_ResetMemoryStats(ShaderCompiler_ContextHandle handle) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx) return;
+	ctx->dxcPeakCompileMemory->store(0, std::memory_order_relaxed);
+}
+
+AL2O3_EXTERN_C void ShaderCompiler_SetTracing(ShaderCompiler_ContextHandle handle, bool enabled) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx) return;
+	delete ctx->tracer;
+	ctx->tracer = enabled ? new ShaderCompiler::Tracer() : nullptr;
+}
+
+AL2O3_EXTERN_C bool ShaderCompiler_WriteTrace(ShaderCompiler_ContextHandle handle, char const *path) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx || !ctx->tracer || !path) return false;
+	return ctx->tracer->Write(path);
+}
+
+AL2O3_EXTERN_C bool ShaderCompiler_SetCacheDirectory(ShaderCompiler_ContextHandle handle, char const *directory) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx) return false;
+
+	delete ctx->diskCache;
+	ctx->diskCache = nullptr;
+	if (!directory) return true;
+
+	ctx->diskCache = ShaderCompiler::DiskCache::Open(directory, ShaderConductor::ToolVersion(), ctx->diskCacheBudget).release();
+	return ctx->diskCache != nullptr;
+}
+
+AL2O3_EXTERN_C void ShaderCompiler_SetCacheDirectoryBudget(ShaderCompiler_ContextHandle handle, uint64_t budget) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx) return;
+
+	ctx->diskCacheBudget = budget;
+	if (ctx->diskCache) ctx->diskCache->SetBudget(budget);
+}
+
+AL2O3_EXTERN_C bool ShaderCompiler_SetCaptureFile(ShaderCompiler_ContextHandle handle, char const *path) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx) return false;
+
+	delete ctx->capture;
+	ctx->capture = nullptr;
+	if (!path) return true;
+
+	// includes already cached wouldn't be loaded (and so recorded) again
+	ctx->includeCache->Clear();
+	ctx->capture = ShaderCompiler::CaptureWriter::Create(path).release();
+	return ctx->capture != nullptr;
+}
+
+AL2O3_EXTERN_C void ShaderCompiler_SetTieredCallback(ShaderCompiler_ContextHandle handle,
+																										 ShaderCompiler_TieredCallback callback,
+																										 void *userData) {
+	auto ctx = (ShaderCompiler_Context *) handle;
+	if (!ctx) return;
+
+	ctx->tieredCallback = callback;
+	ctx->tieredUserData = userData;
+	// the fast options are kept up to date from now on
+	if (callback && !ctx->scFastArgumentCache) {
+		ctx->scFastArgumentCache = ShaderConductor::CreateArgumentCache();
+		ScPrebuildArguments(ctx);
+	}
+}
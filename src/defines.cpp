@@ -0,0 +1,82 @@
+#include "al2o3_platform/platform.h"
+#include "defines.hpp"
+#include <algorithm>
+
+namespace ShaderCompiler {
+
+DefinesPtr DefinesTable::Intern(Defines const *base, ShaderCompiler_Define const *extra, uint32_t extraCount) {
+	uint32_t const baseCount = base ? base->Count() : 0;
+
+	Hasher hasher;
+	hasher.AddValue(baseCount + extraCount);
+	auto addDefine = [&hasher](char const *name, char const *value) {
+		hasher.AddString(name);
+		// a define with no value differs from one with an empty value
+		hasher.AddValue(value != nullptr);
+		hasher.AddString(value);
+	};
+	for (uint32_t i = 0; i < baseCount; ++i) {
+		addDefine(base->Name(i), base->Value(i));
+	}
+	for (uint32_t i = 0; i < extraCount; ++i) {
+		addDefine(extra[i].name, extra[i].value);
+	}
+	Hash128 const hash = hasher.Finish();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = table.find(hash);
+		if (it != table.end()) return it->second;
+	}
+
+	// build outside the lock, if another thread interns the same set first we use theirs
+	std::unique_ptr<Defines> defines(new Defines());
+	defines->hash = hash;
+	auto addOwned = [&defines](char const *name, char const *value) {
+		defines->names.emplace_back(name ? name : "");
+		defines->values.emplace_back(value ? value : "");
+		defines->hasValue.push_back(value != nullptr);
+	};
+	for (uint32_t i = 0; i < baseCount; ++i) {
+		addOwned(base->Name(i), base->Value(i));
+	}
+	for (uint32_t i = 0; i < extraCount; ++i) {
+		addOwned(extra[i].name, extra[i].value);
+	}
+
+	std::vector<ShaderConductor::MacroDefine> macros(defines->Count());
+	for (uint32_t i = 0; i < defines->Count(); ++i) {
+		macros[i] = {defines->Name(i), defines->Value(i)};
+	}
+	defines->scDefineSet.reset(ShaderConductor::CreateDefineSet(macros.data(), defines->Count()));
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto inserted = table.emplace(hash, DefinesPtr(std::move(defines)));
+	if (inserted.second && table.size() > sweepAt) {
+		// copy before sweeping, the new entry is only held by the table until we return it
+		DefinesPtr result = inserted.first->second;
+		Sweep();
+		return result;
+	}
+	return inserted.first->second;
+}
+
+void DefinesTable::Trim() {
+	std::lock_guard<std::mutex> lock(mutex);
+	Sweep();
+}
+
+void DefinesTable::Sweep() {
+	// new references are only handed out by Intern under the mutex, so a count of 1 can't go back up
+	for (auto it = table.begin(); it != table.end();) {
+		if (it->second.use_count() == 1) {
+			it = table.erase(it);
+		} else {
+			++it;
+		}
+	}
+	// if most entries are still held don't sweep again until it doubles
+	sweepAt = std::max(Bound, table.size() * 2);
+}
+
+} // namespace ShaderCompiler
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include "gfx_shadercompiler/compiler.h"
+#include "ShaderConductor/ShaderConductor.hpp"
+#include "hash.hpp"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ShaderCompiler {
+
+// an ordered set of defines, owns its strings and the pre converted ShaderConductor form
+struct Defines {
+	Hash128 hash;
+	std::vector<std::string> names;
+	std::vector<std::string> values;
+	std::vector<bool> hasValue;
+	std::unique_ptr<ShaderConductor::DefineSet, void (*)(ShaderConductor::DefineSet *)> scDefineSet{nullptr, &ShaderConductor::DestroyDefineSet};
+
+	uint32_t Count() const { return (uint32_t) names.size(); }
+	char const *Name(uint32_t i) const { return names[i].c_str(); }
+	char const *Value(uint32_t i) const { return hasValue[i] ? values[i].c_str() : nullptr; }
+};
+
+typedef std::shared_ptr<Defines const> DefinesPtr;
+
+// identical define sets (same names and values in the same order) share one Defines, so each distinct
+// permutation is converted once however many compiles use it. Callers (and queued jobs) hold a DefinesPtr
+// for as long as they use a set, entries nobody else holds are dropped once the table grows past its bound
+class DefinesTable {
+public:
+	static size_t const Bound = 1024;
+
+	// base (can be null) followed by extra
+	DefinesPtr Intern(Defines const *base, ShaderCompiler_Define const *extra, uint32_t extraCount);
+
+	// drops every entry only the table holds
+	void Trim();
+
+private:
+	// call with the mutex held
+	void Sweep();
+
+	std::mutex mutex;
+	std::unordered_map<Hash128, DefinesPtr, Hash128Hasher> table;
+	size_t sweepAt = Bound;
+};
+
+} // namespace ShaderCompiler
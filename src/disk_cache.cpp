@@ -0,0 +1,311 @@
+#include "al2o3_platform/platform.h"
+#include "disk_cache.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace ShaderCompiler {
+
+namespace {
+
+struct EntryHeader {
+	uint32_t magic;
+	uint32_t version;
+	Hash128 key;
+	uint64_t shaderSize;
+	uint64_t logSize;
+	uint32_t includeCount;
+	uint32_t flags;
+};
+
+enum EntryFlags : uint32_t {
+	EF_HasLog = 0x1,
+	// a failed compile, log is the error
+	EF_Failed = 0x2,
+};
+
+struct EntryInclude {
+	Hash128 contentHash;
+	uint64_t nameSize;
+};
+
+// slot keys, a removed slot still has to be probed past as the slots after it may be in the same run
+Hash128 const EmptyKey{0, 0};
+Hash128 const RemovedKey{~0ull, ~0ull};
+
+bool IsFree(Hash128 const& key) {
+	return key == EmptyKey || key == RemovedKey;
+}
+
+void HexKey(Hash128 const& key, char *out) {
+	snprintf(out, 33, "%016llx%016llx", (unsigned long long) key.hi, (unsigned long long) key.lo);
+}
+
+// bounds checked reader over a mapped entry file
+struct Reader {
+	uint8_t const *cur;
+	uint8_t const *end;
+
+	bool Read(void *dst, size_t size) {
+		if ((size_t) (end - cur) < size) return false;
+		memcpy(dst, cur, size);
+		cur += size;
+		return true;
+	}
+	uint8_t const *Skip(size_t size) {
+		if ((size_t) (end - cur) < size) return nullptr;
+		uint8_t const *ret = cur;
+		cur += size;
+		return ret;
+	}
+};
+
+} // end anon namespace
+
+DiskCache::DiskCache(char const *directory, char const *toolVersion, uint64_t budget) :
+		directory(directory), toolVersion(Hasher::Of(toolVersion, strlen(toolVersion))), budget(budget), hits(0), misses(0) {}
+
+std::unique_ptr<DiskCache> DiskCache::Open(char const *directory, char const *toolVersion, uint64_t budget) {
+	if (!EnsureDirectory(directory)) {
+		LOGERROR("Unable to create shader cache directory %s", directory);
+		return nullptr;
+	}
+
+	std::unique_ptr<DiskCache> cache(new DiskCache(directory, toolVersion, budget));
+	std::string const indexPath = cache->directory + "/index.bin";
+	size_t const indexSize = sizeof(IndexHeader) + sizeof(IndexSlot) * SlotCount;
+	if (!cache->index.OpenReadWrite(indexPath.c_str(), indexSize)) {
+		LOGERROR("Unable to map shader cache index %s", indexPath.c_str());
+		return nullptr;
+	}
+
+	auto header = (IndexHeader *) cache->index.Data();
+	if (header->magic != IndexMagic || header->version != FormatVersion || header->slotCount != SlotCount) {
+		// new or from an incompatible version. The entries it had can't be found or counted any more so go too
+		RemoveFiles(directory, ".sce");
+		memset(cache->index.Data(), 0, indexSize);
+		header->magic = IndexMagic;
+		header->version = FormatVersion;
+		header->slotCount = SlotCount;
+	}
+
+	std::lock_guard<std::mutex> lock(cache->mutex);
+	cache->Evict();
+	return cache;
+}
+
+void DiskCache::SetBudget(uint64_t newBudget) {
+	std::lock_guard<std::mutex> lock(mutex);
+	budget = newBudget;
+	Evict();
+}
+
+Hash128 DiskCache::DiskKey(Hash128 const& key) const {
+	Hasher hasher;
+	hasher.AddHash(key);
+	hasher.AddHash(toolVersion);
+	return hasher.Finish();
+}
+
+DiskCache::IndexSlot *DiskCache::FindSlot(Hash128 const& key) const {
+	IndexSlot *slots = Slots();
+	uint32_t const home = (uint32_t) (key.lo & (SlotCount - 1));
+	for (uint32_t i = 0; i < MaxProbes; ++i) {
+		IndexSlot *slot = slots + ((home + i) & (SlotCount - 1));
+		if (slot->key == key) return slot;
+		if (slot->key == EmptyKey) return nullptr;
+	}
+	return nullptr;
+}
+
+void DiskCache::RemoveEntry(IndexSlot *slot) {
+	std::remove(EntryPath(slot->key).c_str());
+	IndexHeader *header = Header();
+	header->totalSize -= std::min(header->totalSize, slot->entrySize);
+	slot->key = RemovedKey;
+	slot->entrySize = 0;
+}
+
+void DiskCache::Evict() {
+	IndexHeader *header = Header();
+	if (budget == 0 || header->totalSize <= budget) return;
+
+	// the total is shared with other processes and can drift, recount it while finding the entries
+	std::vector<IndexSlot *> used;
+	uint64_t totalSize = 0;
+	IndexSlot *slots = Slots();
+	for (uint32_t i = 0; i < SlotCount; ++i) {
+		if (IsFree(slots[i].key)) continue;
+		used.push_back(slots + i);
+		totalSize += slots[i].entrySize;
+	}
+	header->totalSize = totalSize;
+
+	// down to 3/4 of the budget so a full cache isn't scanned again on the next store
+	uint64_t const limit = budget - budget / 4;
+	std::sort(used.begin(), used.end(), [](IndexSlot const *a, IndexSlot const *b) { return a->lastUsed < b->lastUsed; });
+	for (IndexSlot *slot : used) {
+		if (header->totalSize <= limit) break;
+		RemoveEntry(slot);
+	}
+}
+
+std::string DiskCache::EntryPath(Hash128 const& key) const {
+	char hex[33];
+	HexKey(key, hex);
+	return directory + "/" + hex + ".sce";
+}
+
+std::shared_ptr<CachedOutput> DiskCache::Load(Hash128 const& cacheKey, ValidateIncludeFunc validate, void *user) {
+	Hash128 const key = DiskKey(cacheKey);
+	uint64_t expectedSize;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		IndexSlot *slot = FindSlot(key);
+		if (!slot) {
+			misses++;
+			return nullptr;
+		}
+		expectedSize = slot->entrySize;
+		slot->lastUsed = ++Header()->clock;
+	}
+
+	MappedFile file;
+	if (!file.OpenRead(EntryPath(key).c_str()) || file.Size() != expectedSize) {
+		misses++;
+		return nullptr;
+	}
+
+	Reader reader{(uint8_t const *) file.Data(), (uint8_t const *) file.Data() + file.Size()};
+	EntryHeader header;
+	if (!reader.Read(&header, sizeof(EntryHeader)) ||
+			header.magic != EntryMagic || header.version != FormatVersion || header.key != key) {
+		misses++;
+		return nullptr;
+	}
+
+	auto entry = std::make_shared<CachedOutput>();
+	entry->includes.resize(header.includeCount);
+	for (auto& include : entry->includes) {
+		EntryInclude diskInclude;
+		if (!reader.Read(&diskInclude, sizeof(EntryInclude))) {
+			misses++;
+			return nullptr;
+		}
+		char const *name = (char const *) reader.Skip(diskInclude.nameSize);
+		if (!name) {
+			misses++;
+			return nullptr;
+		}
+		include.contentHash = diskInclude.contentHash;
+		include.name.assign(name, diskInclude.nameSize);
+	}
+	// before the shader is copied, an entry made with different includes is no use
+	if (!ValidateIncludes(*entry, validate, user)) {
+		misses++;
+		return nullptr;
+	}
+
+	uint8_t const *shader = reader.Skip(header.shaderSize);
+	char const *log = (char const *) reader.Skip(header.logSize);
+	if (!shader || !log) {
+		misses++;
+		return nullptr;
+	}
+	entry->shader.assign(shader, shader + header.shaderSize);
+	entry->log.assign(log, header.logSize);
+	entry->hasLog = (header.flags & EF_HasLog) != 0;
+	entry->succeeded = (header.flags & EF_Failed) == 0;
+
+	hits++;
+	return entry;
+}
+
+void DiskCache::Store(Hash128 const& cacheKey, CachedOutput const& entry) {
+	Hash128 const key = DiskKey(cacheKey);
+	EntryHeader header{};
+	header.magic = EntryMagic;
+	header.version = FormatVersion;
+	header.key = key;
+	header.shaderSize = entry.shader.size();
+	header.logSize = entry.log.size();
+	header.includeCount = (uint32_t) entry.includes.size();
+	header.flags = (entry.hasLog ? (uint32_t) EF_HasLog : 0u) | (entry.succeeded ? 0u : (uint32_t) EF_Failed);
+
+	// write to a unique temp file and rename into place so readers never see a partial entry
+	std::string const path = EntryPath(key);
+	Hasher tmpHasher;
+	tmpHasher.AddHash(key);
+	tmpHasher.AddValue(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+	tmpHasher.AddValue(std::hash<std::thread::id>()(std::this_thread::get_id()));
+	char tmpHex[33];
+	HexKey(tmpHasher.Finish(), tmpHex);
+	std::string const tmpPath = path + "." + tmpHex + ".tmp";
+
+	FILE *file = fopen(tmpPath.c_str(), "wb");
+	if (!file) return;
+
+	bool okay = fwrite(&header, sizeof(EntryHeader), 1, file) == 1;
+	uint64_t size = sizeof(EntryHeader);
+	for (auto const& include : entry.includes) {
+		EntryInclude const diskInclude{include.contentHash, include.name.size()};
+		okay = okay && fwrite(&diskInclude, sizeof(EntryInclude), 1, file) == 1;
+		okay = okay && fwrite(include.name.data(), 1, include.name.size(), file) == include.name.size();
+		size += sizeof(EntryInclude) + include.name.size();
+	}
+	okay = okay && fwrite(entry.shader.data(), 1, entry.shader.size(), file) == entry.shader.size();
+	okay = okay && fwrite(entry.log.data(), 1, entry.log.size(), file) == entry.log.size();
+	size += entry.shader.size() + entry.log.size();
+	okay = (fclose(file) == 0) && okay;
+
+	if (okay) {
+		okay = std::rename(tmpPath.c_str(), path.c_str()) == 0;
+		if (!okay) {
+			// windows rename won't replace an existing file, whatever is there has the same key so is as good as ours
+			std::remove(path.c_str());
+			okay = std::rename(tmpPath.c_str(), path.c_str()) == 0;
+		}
+	}
+	if (!okay) {
+		std::remove(tmpPath.c_str());
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	IndexHeader *indexHeader = Header();
+	IndexSlot *slots = Slots();
+	uint32_t const home = (uint32_t) (key.lo & (SlotCount - 1));
+	IndexSlot *target = nullptr;
+	IndexSlot *oldest = slots + home;
+	for (uint32_t i = 0; i < MaxProbes; ++i) {
+		IndexSlot *slot = slots + ((home + i) & (SlotCount - 1));
+		if (slot->key == key) {
+			// stored again, the file was replaced by the rename
+			target = slot;
+			indexHeader->totalSize -= std::min(indexHeader->totalSize, slot->entrySize);
+			break;
+		}
+		if (IsFree(slot->key)) {
+			if (!target) target = slot;
+			// nothing is stored past an empty slot, a removed one can have the key further on
+			if (slot->key == EmptyKey) break;
+		} else if (slot->lastUsed < oldest->lastUsed) {
+			oldest = slot;
+		}
+	}
+	if (!target) {
+		// the probe window is full, its least recently used entry makes way
+		RemoveEntry(oldest);
+		target = oldest;
+	}
+	target->key = key;
+	target->entrySize = size;
+	target->lastUsed = ++indexHeader->clock;
+	indexHeader->totalSize += size;
+	Evict();
+}
+
+} // namespace ShaderCompiler
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include "cache.hpp"
+#include "mapped_file.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace ShaderCompiler {
+
+// persistent second tier behind OutputCache. Each result lives in its own file named by its key,
+// index.bin is a memory mapped open addressed table of keys so a lookup is a probe of mapped
+// memory and (on a hit) one read of that entry, regardless of how many entries exist.
+// The index is only a hint, entry files carry their key and are verified on load, so
+// processes sharing a directory can race on the index without returning wrong results.
+// Keys include the compiler versions so an update never returns a result an older one made. When the
+// entries in the index go over budget bytes the least recently used are deleted (0 is no limit), with
+// several processes the total is approximate and is recounted when it looks over
+class DiskCache {
+public:
+	// toolVersion is ShaderConductor::ToolVersion()
+	static std::unique_ptr<DiskCache> Open(char const *directory, char const *toolVersion, uint64_t budget);
+
+	// as OutputCache::Lookup, the entry if present and its includes validate. One that doesn't is a miss
+	std::shared_ptr<CachedOutput> Load(Hash128 const& key, ValidateIncludeFunc validate, void *user);
+	void Store(Hash128 const& key, CachedOutput const& entry);
+	void SetBudget(uint64_t newBudget);
+
+	uint64_t Hits() const { return hits; }
+	uint64_t Misses() const { return misses; }
+
+private:
+	struct IndexHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t slotCount;
+		uint32_t padding;
+		// bytes of entry files in the index
+		uint64_t totalSize;
+		// ticks on every store and hit, slots record when they were last used
+		uint64_t clock;
+	};
+
+	struct IndexSlot {
+		Hash128 key;
+		uint64_t entrySize;
+		uint64_t lastUsed;
+	};
+
+	static uint32_t const IndexMagic = 0x58444953; // SIDX
+	static uint32_t const EntryMagic = 0x45434453; // SDCE
+	static uint32_t const FormatVersion = 4;
+	static uint32_t const SlotCount = 1 << 16;
+	static uint32_t const MaxProbes = 16;
+
+	DiskCache(char const *directory, char const *toolVersion, uint64_t budget);
+
+	IndexHeader *Header() const { return (IndexHeader *) index.Data(); }
+	IndexSlot *Slots() const { return (IndexSlot *) (Header() + 1); }
+	// callers key with the compiler versions added
+	Hash128 DiskKey(Hash128 const& key) const;
+	IndexSlot *FindSlot(Hash128 const& key) const;
+	std::string EntryPath(Hash128 const& key) const;
+	// these need mutex held
+	void RemoveEntry(IndexSlot *slot);
+	void Evict();
+
+	std::string directory;
+	Hash128 toolVersion;
+	std::mutex mutex;
+	MappedFile index;
+	uint64_t budget;
+
+	std::atomic<uint64_t> hits;
+	std::atomic<uint64_t> misses;
+};
+
+} // namespace ShaderCompiler
@@ -18,6 +18,7 @@
 #include "dxc/Support/Global.h"
 #include "dxc/Support/Unicode.h"
 #include "dxc/Support/WinIncludes.h"
+#include "utf_transcode.hpp"
 
 #ifndef _WIN32
 // MultiByteToWideChar which is a Windows-specific method.
@@ -40,6 +41,21 @@ int MultiByteToWideChar(uint32_t CodePage, uint32_t /*dwFlags*/,
 		// Add 1 for the null-terminating character.
 		++cbMultiByte;
 	}
+
+	// UTF-8 doesn't need the locale (which is process wide so races with other threads)
+	if (CodePage == CP_UTF8) {
+		size_t const required = ShaderCompiler::Utf8ToWideLength(lpMultiByteStr, cbMultiByte);
+		if (required == ShaderCompiler::TranscodeError) {
+			SetLastError(ERROR_NO_UNICODE_TRANSLATION);
+			return 0;
+		}
+		if (cchWideChar == 0) return (int)required;
+		if ((size_t)cchWideChar < required) {
+			SetLastError(ERROR_INSUFFICIENT_BUFFER);
+			return 0;
+		}
+		return (int)ShaderCompiler::Utf8ToWide(lpMultiByteStr, cbMultiByte, lpWideCharStr);
+	}
 	// If zero is given as the destination size, this function should
 	// return the required size (including the null-terminating character).
 	// This is the behavior of mbstowcs when the target is null.
@@ -89,6 +105,20 @@ int WideCharToMultiByte(uint32_t CodePage, uint32_t /*dwFlags*/,
 		// Add 1 for the null-terminating character.
 		++cchWideChar;
 	}
+
+	if (CodePage == CP_UTF8) {
+		size_t const required = ShaderCompiler::WideToUtf8Length(lpWideCharStr, cchWideChar);
+		if (required == ShaderCompiler::TranscodeError) {
+			SetLastError(ERROR_NO_UNICODE_TRANSLATION);
+			return 0;
+		}
+		if (cbMultiByte == 0) return (int)required;
+		if ((size_t)cbMultiByte < required) {
+			SetLastError(ERROR_INSUFFICIENT_BUFFER);
+			return 0;
+		}
+		return (int)ShaderCompiler::WideToUtf8(lpWideCharStr, cchWideChar, lpMultiByteStr);
+	}
 	// If zero is given as the destination size, this function should
 	// return the required size (including the null-terminating character).
 	// This is the behavior of wcstombs when the target is null.
@@ -133,6 +163,18 @@ bool UTF16ToEncodedString(_In_z_ const wchar_t* text, DWORD cp, DWORD flags, _In
 		return true;
 	}
 
+	// UTF-8 is converted directly in a single pass into a worst case sized buffer
+	if (cp == CP_UTF8) {
+		pValue->resize(ShaderCompiler::WideToUtf8MaxLength(cUTF16));
+		size_t const cbUTF8 = ShaderCompiler::WideToUtf8(text, cUTF16, &(*pValue)[0]);
+		if (cbUTF8 == ShaderCompiler::TranscodeError) {
+			pValue->resize(0);
+			return false;
+		}
+		pValue->resize(cbUTF8);
+		return true;
+	}
+
 	int cbUTF8 = ::WideCharToMultiByte(cp, flags, text, cUTF16, nullptr, 0, nullptr, pUsedDefaultChar);
 	if (cbUTF8 == 0)
 		return false;
@@ -164,16 +206,14 @@ bool UTF8ToUTF16String(const char *pUTF8, size_t cbUTF8, std::wstring *pUTF16) {
 		return true;
 	}
 
-	int cUTF16 = ::MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, pUTF8,
-																		 cbUTF8, nullptr, 0);
-	if (cUTF16 == 0)
+	// single pass into a worst case sized buffer rather than measure then convert
+	pUTF16->resize(ShaderCompiler::Utf8ToWideMaxLength(cbUTF8));
+	size_t const cUTF16 = ShaderCompiler::Utf8ToWide(pUTF8, cbUTF8, &(*pUTF16)[0]);
+	if (cUTF16 == ShaderCompiler::TranscodeError) {
+		pUTF16->resize(0);
 		return false;
-
+	}
 	pUTF16->resize(cUTF16);
-
-	cUTF16 = ::MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, pUTF8, cbUTF8,
-																 &(*pUTF16)[0], pUTF16->size());
-	DXASSERT(cUTF16 > 0, "otherwise contents changed");
 	DXASSERT((*pUTF16)[pUTF16->size()] == L'\0',
 					 "otherwise wstring didn't null-terminate after resize() call");
 	return true;
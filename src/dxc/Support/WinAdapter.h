@@ -112,6 +112,7 @@
 #define ERROR_OUT_OF_STRUCTURES ENOMEM
 #define ERROR_NOT_CAPABLE EPERM
 #define ERROR_NOT_FOUND ENOTSUP
+#define ERROR_NO_UNICODE_TRANSLATION EILSEQ
 #define ERROR_UNHANDLED_EXCEPTION EINTR
 
 // Used by HRESULT <--> WIN32 error code conversion
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include <cstring>
+#include <functional>
+#include <type_traits>
+
+namespace ShaderCompiler {
+
+// 128 bit content hash, used as the key for everything we cache
+struct Hash128 {
+	uint64_t lo;
+	uint64_t hi;
+
+	bool operator==(Hash128 const& other) const { return lo == other.lo && hi == other.hi; }
+	bool operator!=(Hash128 const& other) const { return !(*this == other); }
+	bool operator<(Hash128 const& other) const { return hi < other.hi || (hi == other.hi && lo < other.lo); }
+};
+
+struct Hash128Hasher {
+	size_t operator()(Hash128 const& h) const { return (size_t) (h.lo ^ (h.hi * 0x9E3779B97F4A7C15ull)); }
+};
+
+// streaming MurmurHash3 x64 128, gives the same result as hashing
+// the concatenation of everything passed to Add in one go
+class Hasher {
+public:
+	explicit Hasher(uint64_t seed = 0) : h1(seed), h2(seed), tailSize(0), totalSize(0) {}
+
+	void Add(void const *data, size_t size) {
+		uint8_t const *bytes = (uint8_t const *) data;
+		totalSize += size;
+
+		if (tailSize) {
+			size_t const fill = (size < 16 - tailSize) ? size : 16 - tailSize;
+			memcpy(tail + tailSize, bytes, fill);
+			tailSize += fill;
+			bytes += fill;
+			size -= fill;
+			if (tailSize < 16) return;
+			Block(tail);
+			tailSize = 0;
+		}
+
+		while (size >= 16) {
+			Block(bytes);
+			bytes += 16;
+			size -= 16;
+		}
+
+		if (size) {
+			memcpy(tail, bytes, size);
+			tailSize = size;
+		}
+	}
+
+	// strings are length prefixed so "ab"+"c" and "a"+"bc" differ, null hashes as empty
+	void AddString(char const *str) {
+		uint64_t const len = str ? strlen(str) : 0;
+		AddValue(len);
+		if (len) Add(str, len);
+	}
+
+	template<typename T>
+	void AddValue(T const& value) {
+		static_assert(std::is_trivially_copyable<T>::value, "AddValue only works on plain values");
+		Add(&value, sizeof(T));
+	}
+
+	void AddHash(Hash128 const& hash) {
+		AddValue(hash.lo);
+		AddValue(hash.hi);
+	}
+
+	Hash128 Finish() const {
+		uint64_t a = h1;
+		uint64_t b = h2;
+		uint64_t k1 = 0;
+		uint64_t k2 = 0;
+
+		switch (tailSize) {
+		case 15: k2 ^= ((uint64_t) tail[14]) << 48;
+			[[fallthrough]];
+		case 14: k2 ^= ((uint64_t) tail[13]) << 40;
+			[[fallthrough]];
+		case 13: k2 ^= ((uint64_t) tail[12]) << 32;
+			[[fallthrough]];
+		case 12: k2 ^= ((uint64_t) tail[11]) << 24;
+			[[fallthrough]];
+		case 11: k2 ^= ((uint64_t) tail[10]) << 16;
+			[[fallthrough]];
+		case 10: k2 ^= ((uint64_t) tail[9]) << 8;
+			[[fallthrough]];
+		case 9: k2 ^= ((uint64_t) tail[8]);
+			k2 *= C2;
+			k2 = Rotl(k2, 33);
+			k2 *= C1;
+			b ^= k2;
+			[[fallthrough]];
+		case 8: k1 ^= ((uint64_t) tail[7]) << 56;
+			[[fallthrough]];
+		case 7: k1 ^= ((uint64_t) tail[6]) << 48;
+			[[fallthrough]];
+		case 6: k1 ^= ((uint64_t) tail[5]) << 40;
+			[[fallthrough]];
+		case 5: k1 ^= ((uint64_t) tail[4]) << 32;
+			[[fallthrough]];
+		case 4: k1 ^= ((uint64_t) tail[3]) << 24;
+			[[fallthrough]];
+		case 3: k1 ^= ((uint64_t) tail[2]) << 16;
+			[[fallthrough]];
+		case 2: k1 ^= ((uint64_t) tail[1]) << 8;
+			[[fallthrough]];
+		case 1: k1 ^= ((uint64_t) tail[0]);
+			k1 *= C1;
+			k1 = Rotl(k1, 31);
+			k1 *= C2;
+			a ^= k1;
+			[[fallthrough]];
+		default: break;
+		}
+
+		a ^= totalSize;
+		b ^= totalSize;
+		a += b;
+		b += a;
+		a = FMix(a);
+		b = FMix(b);
+		a += b;
+		b += a;
+		return Hash128{a, b};
+	}
+
+	static Hash128 Of(void const *data, size_t size) {
+		Hasher hasher;
+		hasher.Add(data, size);
+		return hasher.Finish();
+	}
+
+private:
+	static constexpr uint64_t C1 = 0x87c37b91114253d5ull;
+	static constexpr uint64_t C2 = 0x4cf5ad432745937full;
+
+	static uint64_t Rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+	static uint64_t FMix(uint64_t k) {
+		k ^= k >> 33;
+		k *= 0xff51afd7ed558ccdull;
+		k ^= k >> 33;
+		k *= 0xc4ceb9fe1a85ec53ull;
+		k ^= k >> 33;
+		return k;
+	}
+
+	void Block(uint8_t const *block) {
+		uint64_t k1;
+		uint64_t k2;
+		memcpy(&k1, block, 8);
+		memcpy(&k2, block + 8, 8);
+
+		k1 *= C1;
+		k1 = Rotl(k1, 31);
+		k1 *= C2;
+		h1 ^= k1;
+		h1 = Rotl(h1, 27);
+		h1 += h2;
+		h1 = h1 * 5 + 0x52dce729;
+
+		k2 *= C2;
+		k2 = Rotl(k2, 33);
+		k2 *= C1;
+		h2 ^= k2;
+		h2 = Rotl(h2, 31);
+		h2 += h1;
+		h2 = h2 * 5 + 0x38495ab5;
+	}
+
+	uint64_t h1;
+	uint64_t h2;
+	uint8_t tail[16];
+	size_t tailSize;
+	uint64_t totalSize;
+};
+
+} // namespace ShaderCompiler
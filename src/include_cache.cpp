@@ -0,0 +1,72 @@
+#include "al2o3_platform/platform.h"
+#include "include_cache.hpp"
+
+namespace ShaderCompiler {
+
+IncludeFile::IncludeFile(ShaderConductor::Blob *blob, FileStamp const& stamp) :
+		blob(blob),
+		contentHash(Hasher::Of(blob->Data(), blob->Size())),
+		stamp(stamp) {
+}
+
+IncludeFile::~IncludeFile() {
+	ShaderConductor::DestroyBlob(blob);
+}
+
+IncludeFilePtr IncludeCache::Get(char const *name, LoadIncludeFunc load, void *user, bool fromDisk) {
+	std::string key(name);
+	bool found = false;
+	IncludeFilePtr cached;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = files.find(key);
+		if (it != files.end()) {
+			found = true;
+			cached = it->second;
+		}
+	}
+	if (found && !fromDisk) return cached;
+
+	// stamped before reading, a write that lands after this is seen by the next Get
+	FileStamp stamp{};
+	if (fromDisk) {
+		bool const exists = GetFileStamp(name, &stamp);
+		if (cached && exists && stamp == cached->stamp) return cached;
+	}
+
+	// loading calls user code so is done without the lock, if another thread loads the same
+	// include first we use theirs so every compile sees the same contents
+	ShaderConductor::Blob *blob = load(user, name);
+	auto file = blob ? std::make_shared<IncludeFile>(blob, stamp) : nullptr;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = files.find(key);
+	if (it == files.end()) {
+		if (file || !fromDisk) files.emplace(std::move(key), file);
+		return file;
+	}
+	if (!found || it->second != cached) return it->second;
+
+	// replaces the out of date disk include we found (another thread hasn't already)
+	if (file) {
+		it->second = file;
+	} else {
+		files.erase(it);
+	}
+	generation++;
+	return file;
+}
+
+void IncludeCache::Invalidate(char const *name) {
+	std::lock_guard<std::mutex> lock(mutex);
+	files.erase(name);
+	generation++;
+}
+
+void IncludeCache::Clear() {
+	std::lock_guard<std::mutex> lock(mutex);
+	files.clear();
+	generation++;
+}
+
+} // namespace ShaderCompiler
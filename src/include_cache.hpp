@@ -0,0 +1,66 @@
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include "ShaderConductor/ShaderConductor.hpp"
+#include "hash.hpp"
+#include "mapped_file.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace ShaderCompiler {
+
+// the loaded contents of an include and their hash, immutable once made
+struct IncludeFile {
+	IncludeFile(ShaderConductor::Blob *blob, FileStamp const& stamp);
+	~IncludeFile();
+	IncludeFile(IncludeFile const&) = delete;
+	IncludeFile& operator=(IncludeFile const&) = delete;
+
+	ShaderConductor::Blob *blob;
+	Hash128 contentHash;
+	// the file on disk as it was just before it was read, only for includes loaded from disk
+	FileStamp stamp;
+};
+typedef std::shared_ptr<IncludeFile const> IncludeFilePtr;
+
+// a Blob viewing a cached include, keeps it alive without copying the contents
+class IncludeFileBlob : public ShaderConductor::Blob {
+public:
+	explicit IncludeFileBlob(IncludeFilePtr file) : file(std::move(file)) {}
+
+	void const *Data() const override { return file->blob->Data(); }
+	uint32_t Size() const override { return file->blob->Size(); }
+
+private:
+	IncludeFilePtr file;
+};
+
+// returns a new blob the caller owns or null if the include can't be found
+typedef ShaderConductor::Blob *(*LoadIncludeFunc)(void *user, char const *name);
+
+// includes by name, each is loaded once and then shared by every compile until invalidated.
+// failed loads are cached too, DXC looks for each include at several paths so a missing include stays
+// missing (and costs no lookup) until it is invalidated.
+// nobody invalidates files on disk, with fromDisk (load reads the file at name) an include is checked
+// (size and last write time) every Get and read again if it changed, and a miss is looked for again
+// next time so a header created later is seen
+class IncludeCache {
+public:
+	IncludeFilePtr Get(char const *name, LoadIncludeFunc load, void *user, bool fromDisk);
+	void Invalidate(char const *name);
+	void Clear();
+
+	// changes every time something is invalidated (or reloaded from disk), compiles that start with the same generation see the same includes
+	uint64_t Generation() const { return generation.load(std::memory_order_acquire); }
+
+private:
+	std::atomic<uint64_t> generation{0};
+	std::mutex mutex;
+	// null for an include that wasn't found (never from disk)
+	std::unordered_map<std::string, IncludeFilePtr> files;
+};
+
+} // namespace ShaderCompiler
@@ -0,0 +1,211 @@
+#include "al2o3_platform/platform.h"
+#include "mapped_file.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#if AL2O3_PLATFORM == AL2O3_PLATFORM_WINDOWS
+#include <windows.h>
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ShaderCompiler {
+
+#if AL2O3_PLATFORM == AL2O3_PLATFORM_WINDOWS
+
+bool MappedFile::OpenRead(char const *path) {
+	Close();
+	HANDLE file = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+															OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize;
+	if (!::GetFileSizeEx(file, &fileSize)) {
+		::CloseHandle(file);
+		return false;
+	}
+	fileHandle = file;
+	size = (size_t) fileSize.QuadPart;
+	opened = Map(false);
+	if (!opened) Close();
+	return opened;
+}
+
+bool MappedFile::OpenReadWrite(char const *path, size_t minSize) {
+	Close();
+	HANDLE file = ::CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+															OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize;
+	if (!::GetFileSizeEx(file, &fileSize)) {
+		::CloseHandle(file);
+		return false;
+	}
+	fileHandle = file;
+	size = (size_t) fileSize.QuadPart;
+	if (size < minSize) {
+		// a mapping larger than the file extends it (zero filled)
+		size = minSize;
+	}
+	opened = Map(true);
+	if (!opened) Close();
+	return opened;
+}
+
+bool MappedFile::Map(bool writable) {
+	if (size == 0) return true;
+
+	LARGE_INTEGER mapSize;
+	mapSize.QuadPart = (LONGLONG) size;
+	mappingHandle = ::CreateFileMappingA((HANDLE) fileHandle, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+																			 mapSize.HighPart, mapSize.LowPart, nullptr);
+	if (!mappingHandle) return false;
+
+	data = ::MapViewOfFile((HANDLE) mappingHandle, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+	return data != nullptr;
+}
+
+void MappedFile::Close() {
+	if (data) ::UnmapViewOfFile(data);
+	if (mappingHandle) ::CloseHandle((HANDLE) mappingHandle);
+	if (fileHandle) ::CloseHandle((HANDLE) fileHandle);
+	data = nullptr;
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+	size = 0;
+	opened = false;
+}
+
+bool GetFileStamp(char const *path, FileStamp *stamp) {
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!::GetFileAttributesExA(path, GetFileExInfoStandard, &attributes)) return false;
+	if (attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) return false;
+	stamp->size = ((uint64_t) attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+	stamp->modified = ((uint64_t) attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+bool EnsureDirectory(char const *path) {
+	if (_mkdir(path) == 0) return true;
+	DWORD const attributes = ::GetFileAttributesA(path);
+	return (attributes != INVALID_FILE_ATTRIBUTES) && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+}
+
+void RemoveFiles(char const *directory, char const *suffix) {
+	std::string const base = std::string(directory) + "/";
+	WIN32_FIND_DATAA found;
+	HANDLE find = ::FindFirstFileA((base + "*" + suffix).c_str(), &found);
+	if (find == INVALID_HANDLE_VALUE) return;
+	do {
+		if (!(found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+			::DeleteFileA((base + found.cFileName).c_str());
+		}
+	} while (::FindNextFileA(find, &found));
+	::FindClose(find);
+}
+
+#else
+
+bool MappedFile::OpenRead(char const *path) {
+	Close();
+	fd = ::open(path, O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (::fstat(fd, &st) != 0) {
+		Close();
+		return false;
+	}
+	size = (size_t) st.st_size;
+	opened = Map(false);
+	if (!opened) Close();
+	return opened;
+}
+
+bool MappedFile::OpenReadWrite(char const *path, size_t minSize) {
+	Close();
+	fd = ::open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (::fstat(fd, &st) != 0) {
+		Close();
+		return false;
+	}
+	size = (size_t) st.st_size;
+	if (size < minSize) {
+		if (::ftruncate(fd, (off_t) minSize) != 0) {
+			Close();
+			return false;
+		}
+		size = minSize;
+	}
+	opened = Map(true);
+	if (!opened) Close();
+	return opened;
+}
+
+bool MappedFile::Map(bool writable) {
+	// mmap refuses zero length, an empty file is just an open file with no data
+	if (size == 0) return true;
+
+	int const prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+	void *mem = ::mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+	if (mem == MAP_FAILED) return false;
+	data = mem;
+	return true;
+}
+
+void MappedFile::Close() {
+	if (data) ::munmap(data, size);
+	if (fd >= 0) ::close(fd);
+	data = nullptr;
+	fd = -1;
+	size = 0;
+	opened = false;
+}
+
+bool GetFileStamp(char const *path, FileStamp *stamp) {
+	struct stat st;
+	if (::stat(path, &st) != 0 || !S_ISREG(st.st_mode)) return false;
+	stamp->size = (uint64_t) st.st_size;
+#if AL2O3_PLATFORM == AL2O3_PLATFORM_APPLE_MAC
+	stamp->modified = (uint64_t) st.st_mtimespec.tv_sec * 1000000000ull + (uint64_t) st.st_mtimespec.tv_nsec;
+#else
+	stamp->modified = (uint64_t) st.st_mtim.tv_sec * 1000000000ull + (uint64_t) st.st_mtim.tv_nsec;
+#endif
+	return true;
+}
+
+bool EnsureDirectory(char const *path) {
+	if (::mkdir(path, 0755) == 0) return true;
+	if (errno != EEXIST) return false;
+	struct stat st;
+	return (::stat(path, &st) == 0) && S_ISDIR(st.st_mode);
+}
+
+void RemoveFiles(char const *directory, char const *suffix) {
+	DIR *dir = ::opendir(directory);
+	if (!dir) return;
+	std::string const base = std::string(directory) + "/";
+	size_t const suffixSize = strlen(suffix);
+	while (struct dirent *entry = ::readdir(dir)) {
+		size_t const nameSize = strlen(entry->d_name);
+		if (nameSize >= suffixSize && strcmp(entry->d_name + nameSize - suffixSize, suffix) == 0) {
+			std::remove((base + entry->d_name).c_str());
+		}
+	}
+	::closedir(dir);
+}
+
+#endif
+
+} // namespace ShaderCompiler
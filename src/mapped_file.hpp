@@ -0,0 +1,54 @@
+#pragma once
+
+#include "al2o3_platform/platform.h"
+
+namespace ShaderCompiler {
+
+// a file mapped into memory, read only or read/write (shared with other processes)
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile() { Close(); }
+	MappedFile(MappedFile const&) = delete;
+	MappedFile& operator=(MappedFile const&) = delete;
+
+	bool OpenRead(char const *path);
+	// creates the file if needed and grows it to at least size bytes, new space is zeroed
+	bool OpenReadWrite(char const *path, size_t size);
+	void Close();
+
+	bool IsOpen() const { return opened; }
+	void *Data() const { return data; }
+	size_t Size() const { return size; }
+
+private:
+	bool Map(bool writable);
+
+	void *data = nullptr;
+	size_t size = 0;
+	bool opened = false;
+#if AL2O3_PLATFORM == AL2O3_PLATFORM_WINDOWS
+	void *fileHandle = nullptr;
+	void *mappingHandle = nullptr;
+#else
+	int fd = -1;
+#endif
+};
+
+// a file's size and last write time, a file that is written (or replaced) gets a different stamp
+struct FileStamp {
+	uint64_t size;
+	uint64_t modified;
+
+	bool operator==(FileStamp const& other) const { return size == other.size && modified == other.modified; }
+	bool operator!=(FileStamp const& other) const { return !(*this == other); }
+};
+// false if there is no file at path
+bool GetFileStamp(char const *path, FileStamp *stamp);
+
+// creates the directory (not its parents) if it doesn't already exist
+bool EnsureDirectory(char const *path);
+// deletes the files in directory (not in its subdirectories) whose names end with suffix
+void RemoveFiles(char const *directory, char const *suffix);
+
+} // namespace ShaderCompiler
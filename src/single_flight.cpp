@@ -0,0 +1,58 @@
+#include "al2o3_platform/platform.h"
+#include "single_flight.hpp"
+
+namespace ShaderCompiler {
+
+bool SingleFlight::Wait(Hash128 const& key, EntryPtr& result, bool& succeeded) {
+	std::shared_ptr<Flight> flight;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = flights.find(key);
+		if (it == flights.end()) {
+			flights.emplace(key, std::make_shared<Flight>());
+			return false;
+		}
+		flight = it->second;
+		flight->waiters++;
+	}
+
+	std::unique_lock<std::mutex> lock(flight->mutex);
+	flight->condition.wait(lock, [&flight] { return flight->done; });
+	result = flight->result;
+	succeeded = flight->succeeded;
+	return true;
+}
+
+void SingleFlight::Finish(Hash128 const& key, bool succeeded, MakeResultFunc const& makeResult) {
+	std::shared_ptr<Flight> flight;
+	{
+		// once it is out of the map nobody else can start waiting on it
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = flights.find(key);
+		if (it == flights.end()) return;
+		flight = std::move(it->second);
+		flights.erase(it);
+	}
+	if (flight->waiters == 0) return;
+
+	auto publish = [&flight](EntryPtr result, bool succeeded) {
+		{
+			std::lock_guard<std::mutex> lock(flight->mutex);
+			flight->result = std::move(result);
+			flight->succeeded = succeeded;
+			flight->done = true;
+		}
+		flight->condition.notify_all();
+	};
+
+	EntryPtr result;
+	try {
+		result = makeResult();
+	} catch (...) {
+		publish(nullptr, false);
+		throw;
+	}
+	publish(std::move(result), succeeded);
+}
+
+} // namespace ShaderCompiler
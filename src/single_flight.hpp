@@ -0,0 +1,67 @@
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include "cache.hpp"
+#include "hash.hpp"
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace ShaderCompiler {
+
+// the compiles that are running by key, so an identical compile started meanwhile waits for the running
+// one and shares its result instead of doing the same work again
+class SingleFlight {
+public:
+	typedef OutputCache::EntryPtr EntryPtr;
+	typedef std::function<EntryPtr()> MakeResultFunc;
+
+	// if a compile of key is running waits for it and returns true, result is what it produced (shader and
+	// or log, null if it threw) and succeeded whether it worked. Otherwise returns false and the caller is now
+	// running key and must call Finish when done (SingleFlightLeader makes sure it does)
+	bool Wait(Hash128 const& key, EntryPtr& result, bool& succeeded);
+
+	// hands the result to everyone waiting on key, makeResult is only called if someone is.
+	// if makeResult throws the waiters are released with a failure and the exception carries on
+	void Finish(Hash128 const& key, bool succeeded, MakeResultFunc const& makeResult);
+
+private:
+	struct Flight {
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool done = false;
+		bool succeeded = false;
+		EntryPtr result;
+		// only changed with SingleFlight::mutex held while the flight is in flights
+		uint32_t waiters = 0;
+	};
+
+	std::mutex mutex;
+	std::unordered_map<Hash128, std::shared_ptr<Flight>, Hash128Hasher> flights;
+};
+
+// held by the caller that Wait returned false to, if it goes (an exception...) without Finish being
+// called the waiters are released with a failure rather than blocking forever
+class SingleFlightLeader {
+public:
+	SingleFlightLeader(SingleFlight& flights, Hash128 const& key) : flights(flights), key(key), finished(false) {}
+	~SingleFlightLeader() {
+		if (!finished) flights.Finish(key, false, []() { return SingleFlight::EntryPtr(); });
+	}
+	SingleFlightLeader(SingleFlightLeader const&) = delete;
+	SingleFlightLeader& operator=(SingleFlightLeader const&) = delete;
+
+	void Finish(bool succeeded, SingleFlight::MakeResultFunc const& makeResult) {
+		finished = true;
+		flights.Finish(key, succeeded, makeResult);
+	}
+
+private:
+	SingleFlight& flights;
+	Hash128 const key;
+	bool finished;
+};
+
+} // namespace ShaderCompiler
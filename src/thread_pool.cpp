@@ -0,0 +1,139 @@
+#include "al2o3_platform/platform.h"
+#include "thread_pool.hpp"
+
+namespace ShaderCompiler {
+
+namespace {
+thread_local ThreadPool *currentPool = nullptr;
+thread_local uint32_t currentWorker = 0;
+
+uint32_t ResolveThreadCount(uint32_t threadCount) {
+	if (threadCount == 0) {
+		threadCount = std::thread::hardware_concurrency();
+		if (threadCount == 0) threadCount = 1;
+	}
+	return threadCount;
+}
+} // end anon namespace
+
+ThreadPool::ThreadPool(uint32_t requestedThreads) :
+		threadCount(ResolveThreadCount(requestedThreads)), pending(0), nextQueue(0), quit(false) {
+	queues.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; ++i) {
+		queues.emplace_back(new Queue());
+	}
+	workers.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; ++i) {
+		workers.emplace_back(&ThreadPool::WorkerMain, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::Submit(Task task) {
+	uint32_t const queueIndex = (currentPool == this) ? currentWorker : (nextQueue++ % ThreadCount());
+	Push(queueIndex, std::move(task));
+}
+
+void ThreadPool::ParallelFor(uint32_t count, std::function<void(uint32_t)> const& fn) {
+	if (count == 0) return;
+
+	std::mutex doneMutex;
+	std::condition_variable doneCondition;
+	uint32_t remaining = count;
+
+	// contiguous blocks per worker keeps neighbouring items together, stealing evens out the rest
+	uint32_t const threads = ThreadCount();
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t const queueIndex = (uint32_t) (((uint64_t) i * threads) / count);
+		Push(queueIndex, [i, &fn, &doneMutex, &doneCondition, &remaining]() {
+			fn(i);
+			std::lock_guard<std::mutex> lock(doneMutex);
+			if (--remaining == 0) {
+				doneCondition.notify_all();
+			}
+		});
+	}
+
+	std::unique_lock<std::mutex> lock(doneMutex);
+	doneCondition.wait(lock, [&remaining]() { return remaining == 0; });
+}
+
+bool ThreadPool::OnWorkerThread() {
+	return currentPool != nullptr;
+}
+
+void ThreadPool::Push(uint32_t queueIndex, Task&& task) {
+	{
+		// counted before it is queued so a worker taking it straight away never takes pending below 0,
+		// and under the sleep lock so a worker about to sleep can't miss it
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		pending++;
+	}
+	{
+		Queue& queue = *queues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+	wake.notify_one();
+}
+
+bool ThreadPool::Pop(uint32_t workerIndex, Task& task) {
+	{
+		Queue& own = *queues[workerIndex];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			return true;
+		}
+	}
+
+	uint32_t const count = ThreadCount();
+	for (uint32_t i = 1; i < count; ++i) {
+		Queue& victim = *queues[(workerIndex + i) % count];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::WorkerMain(uint32_t workerIndex) {
+	currentPool = this;
+	currentWorker = workerIndex;
+
+	Task task;
+	while (true) {
+		if (Pop(workerIndex, task)) {
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				pending--;
+			}
+			task();
+			task = nullptr;
+			continue;
+		}
+
+		// pending can be above 0 for a moment before the task is in a queue, the next Pop finds it
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this]() { return quit || pending > 0; });
+		if (quit && pending == 0) break;
+	}
+
+	currentPool = nullptr;
+}
+
+} // namespace ShaderCompiler
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ShaderCompiler {
+
+// work stealing pool, each worker has its own deque and takes from its back (most recently
+// queued, still in cache), idle workers steal from the front of the others.
+// tasks queued when the pool is destroyed are run before the workers exit
+class ThreadPool {
+public:
+	typedef std::function<void()> Task;
+
+	// 0 threads uses one per hardware thread
+	explicit ThreadPool(uint32_t threadCount);
+	~ThreadPool();
+	ThreadPool(ThreadPool const&) = delete;
+	ThreadPool& operator=(ThreadPool const&) = delete;
+
+	uint32_t ThreadCount() const { return threadCount; }
+
+	// queued on the calling workers own deque if called from a task, otherwise round robin
+	void Submit(Task task);
+
+	// runs fn(0..count-1) spread over the workers in contiguous blocks, returns when all are done.
+	// must not be called from a task running on this pool
+	void ParallelFor(uint32_t count, std::function<void(uint32_t)> const& fn);
+
+	// true when called from a task running on any pool
+	static bool OnWorkerThread();
+
+private:
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	void Push(uint32_t queueIndex, Task&& task);
+	bool Pop(uint32_t workerIndex, Task& task);
+	void WorkerMain(uint32_t workerIndex);
+
+	// set before any worker starts, workers is still being filled in while the first ones run
+	uint32_t const threadCount;
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	// tasks submitted and not yet taken, only changed with sleepMutex held
+	uint64_t pending;
+	std::atomic<uint32_t> nextQueue;
+	bool quit;
+};
+
+} // namespace ShaderCompiler
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include <chrono>
+
+namespace ShaderCompiler {
+
+// nanoseconds on a monotonic clock, only the difference between two readings means anything.
+// everything that times a compile uses this so phases from different layers line up
+inline uint64_t NowNs() {
+	return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// adds the time it was alive to *total, does nothing (not even read the clock) if total is null
+class ScopedTime {
+public:
+	explicit ScopedTime(uint64_t *total) : total(total), begin(total ? NowNs() : 0) {}
+	~ScopedTime() {
+		if (total) *total += NowNs() - begin;
+	}
+	ScopedTime(ScopedTime const&) = delete;
+	ScopedTime& operator=(ScopedTime const&) = delete;
+
+private:
+	uint64_t *total;
+	uint64_t const begin;
+};
+
+} // namespace ShaderCompiler
@@ -0,0 +1,78 @@
+#include "al2o3_platform/platform.h"
+#include "trace.hpp"
+#include "timing.hpp"
+#include <atomic>
+#include <cstdio>
+
+namespace ShaderCompiler {
+
+namespace {
+// small ids read better than OS thread ids in the viewer, each thread gets the next one the first time it records
+std::atomic<uint32_t> nextThreadId(1);
+
+uint32_t ThreadId() {
+	static thread_local uint32_t const id = nextThreadId++;
+	return id;
+}
+
+void WriteEscaped(FILE *file, char const *str) {
+	for (; *str; ++str) {
+		unsigned char const c = (unsigned char) *str;
+		if (c == '"' || c == '\\') {
+			fputc('\\', file);
+			fputc(c, file);
+		} else if (c < 0x20) {
+			fprintf(file, "\\u%04x", c);
+		} else {
+			fputc(c, file);
+		}
+	}
+}
+} // end anon namespace
+
+Tracer::Tracer() : startNs(NowNs()) {
+}
+
+void Tracer::Record(char const *name, char const *detail, uint64_t beginNs, uint64_t endNs) {
+	uint32_t const thread = ThreadId();
+	std::lock_guard<std::mutex> lock(mutex);
+	events.push_back({name, detail ? detail : "", beginNs, endNs, thread});
+}
+
+bool Tracer::Write(char const *path) const {
+	FILE *file = fopen(path, "wb");
+	if (!file) return false;
+
+	fputs("{\"traceEvents\":[\n", file);
+	fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"shader compiler\"}}", file);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto const& event : events) {
+			// complete events, timestamps in microseconds from when tracing started
+			uint64_t const begin = event.beginNs > startNs ? event.beginNs - startNs : 0;
+			uint64_t const duration = event.endNs > event.beginNs ? event.endNs - event.beginNs : 0;
+			fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+							event.name, event.thread, begin / 1000.0, duration / 1000.0);
+			if (!event.detail.empty()) {
+				fputs(",\"args\":{\"name\":\"", file);
+				WriteEscaped(file, event.detail.c_str());
+				fputs("\"}", file);
+			}
+			fputc('}', file);
+		}
+	}
+	fputs("\n]}\n", file);
+
+	bool const ok = ferror(file) == 0;
+	return (fclose(file) == 0) && ok;
+}
+
+TraceScope::TraceScope(Tracer *tracer, char const *name, char const *detail) :
+		tracer(tracer), name(name), detail(detail), begin(tracer ? NowNs() : 0) {
+}
+
+TraceScope::~TraceScope() {
+	if (tracer) tracer->Record(name, detail, begin, NowNs());
+}
+
+} // namespace ShaderCompiler
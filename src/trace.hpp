@@ -0,0 +1,51 @@
+#pragma once
+
+#include "al2o3_platform/platform.h"
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ShaderCompiler {
+
+// records spans of work (a shader compile, a phase of one, an include load) with the thread that did
+// them and writes them as Chrome trace event JSON (chrome://tracing, ui.perfetto.dev). Times are NowNs.
+// safe to record into from any number of threads
+class Tracer {
+public:
+	Tracer();
+
+	// name must be a string literal (it isn't copied), detail (a shader or include name) can be null
+	void Record(char const *name, char const *detail, uint64_t beginNs, uint64_t endNs);
+
+	bool Write(char const *path) const;
+
+private:
+	struct Event {
+		char const *name;
+		std::string detail;
+		uint64_t beginNs;
+		uint64_t endNs;
+		uint32_t thread;
+	};
+
+	uint64_t const startNs;
+	mutable std::mutex mutex;
+	std::vector<Event> events;
+};
+
+// records the span it was alive for, does nothing if tracer is null
+class TraceScope {
+public:
+	TraceScope(Tracer *tracer, char const *name, char const *detail);
+	~TraceScope();
+	TraceScope(TraceScope const&) = delete;
+	TraceScope& operator=(TraceScope const&) = delete;
+
+private:
+	Tracer *tracer;
+	char const *name;
+	char const *detail;
+	uint64_t const begin;
+};
+
+} // namespace ShaderCompiler
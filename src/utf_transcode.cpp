@@ -0,0 +1,268 @@
+#include "utf_transcode.hpp"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRANSCODE_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define TRANSCODE_NEON 1
+#endif
+
+namespace ShaderCompiler {
+
+namespace {
+
+bool const WideIs16Bit = sizeof(wchar_t) == 2;
+
+// converts whole blocks of 16 ASCII bytes, returns how many bytes were done (stops at the first
+// block with anything that isn't ASCII)
+template<bool Write>
+size_t AsciiToWide(uint8_t const *src, size_t size, wchar_t *dst) {
+	size_t i = 0;
+#if TRANSCODE_SSE2
+	__m128i const zero = _mm_setzero_si128();
+	for (; i + 16 <= size; i += 16) {
+		__m128i const bytes = _mm_loadu_si128((__m128i const *) (src + i));
+		if (_mm_movemask_epi8(bytes) != 0) break;
+		if (!Write) continue;
+
+		__m128i const lo = _mm_unpacklo_epi8(bytes, zero);
+		__m128i const hi = _mm_unpackhi_epi8(bytes, zero);
+		__m128i *out = (__m128i *) (dst + i);
+		if (WideIs16Bit) {
+			_mm_storeu_si128(out + 0, lo);
+			_mm_storeu_si128(out + 1, hi);
+		} else {
+			_mm_storeu_si128(out + 0, _mm_unpacklo_epi16(lo, zero));
+			_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo, zero));
+			_mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi, zero));
+			_mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi, zero));
+		}
+	}
+#elif TRANSCODE_NEON
+	for (; i + 16 <= size; i += 16) {
+		uint8x16_t const bytes = vld1q_u8(src + i);
+		if (vmaxvq_u8(bytes) >= 0x80) break;
+		if (!Write) continue;
+
+		uint16x8_t const lo = vmovl_u8(vget_low_u8(bytes));
+		uint16x8_t const hi = vmovl_u8(vget_high_u8(bytes));
+		if (WideIs16Bit) {
+			uint16_t *out = (uint16_t *) (dst + i);
+			vst1q_u16(out + 0, lo);
+			vst1q_u16(out + 8, hi);
+		} else {
+			uint32_t *out = (uint32_t *) (dst + i);
+			vst1q_u32(out + 0, vmovl_u16(vget_low_u16(lo)));
+			vst1q_u32(out + 4, vmovl_u16(vget_high_u16(lo)));
+			vst1q_u32(out + 8, vmovl_u16(vget_low_u16(hi)));
+			vst1q_u32(out + 12, vmovl_u16(vget_high_u16(hi)));
+		}
+	}
+#else
+	// 8 bytes at a time, just the test is vectorised
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, src + i, sizeof(word));
+		if (word & 0x8080808080808080ull) break;
+		if (!Write) continue;
+		for (size_t j = 0; j < 8; ++j) {
+			dst[i + j] = (wchar_t) src[i + j];
+		}
+	}
+#endif
+	return i;
+}
+
+// as AsciiToWide the other way, blocks of 16 wchar_t that are all below 0x80
+template<bool Write>
+size_t WideToAscii(wchar_t const *src, size_t count, uint8_t *dst) {
+	size_t i = 0;
+#if TRANSCODE_SSE2
+	__m128i const zero = _mm_setzero_si128();
+	for (; i + 16 <= count; i += 16) {
+		__m128i const *in = (__m128i const *) (src + i);
+		__m128i packed;
+		if (WideIs16Bit) {
+			__m128i const a = _mm_loadu_si128(in + 0);
+			__m128i const b = _mm_loadu_si128(in + 1);
+			__m128i const high = _mm_and_si128(_mm_or_si128(a, b), _mm_set1_epi16((short) 0xFF80));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(high, zero)) != 0xFFFF) break;
+			if (!Write) continue;
+			packed = _mm_packus_epi16(a, b);
+		} else {
+			__m128i const a = _mm_loadu_si128(in + 0);
+			__m128i const b = _mm_loadu_si128(in + 1);
+			__m128i const c = _mm_loadu_si128(in + 2);
+			__m128i const d = _mm_loadu_si128(in + 3);
+			__m128i const all = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+			__m128i const high = _mm_and_si128(all, _mm_set1_epi32((int) 0xFFFFFF80));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(high, zero)) != 0xFFFF) break;
+			if (!Write) continue;
+			// everything is < 0x80 so the saturating packs are plain narrows
+			packed = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+		}
+		_mm_storeu_si128((__m128i *) (dst + i), packed);
+	}
+#elif TRANSCODE_NEON
+	for (; i + 16 <= count; i += 16) {
+		uint8x16_t packed;
+		if (WideIs16Bit) {
+			uint16_t const *in = (uint16_t const *) (src + i);
+			uint16x8_t const a = vld1q_u16(in + 0);
+			uint16x8_t const b = vld1q_u16(in + 8);
+			if (vmaxvq_u16(vorrq_u16(a, b)) >= 0x80) break;
+			if (!Write) continue;
+			packed = vcombine_u8(vmovn_u16(a), vmovn_u16(b));
+		} else {
+			uint32_t const *in = (uint32_t const *) (src + i);
+			uint32x4_t const a = vld1q_u32(in + 0);
+			uint32x4_t const b = vld1q_u32(in + 4);
+			uint32x4_t const c = vld1q_u32(in + 8);
+			uint32x4_t const d = vld1q_u32(in + 12);
+			if (vmaxvq_u32(vorrq_u32(vorrq_u32(a, b), vorrq_u32(c, d))) >= 0x80) break;
+			if (!Write) continue;
+			uint16x8_t const ab = vcombine_u16(vmovn_u32(a), vmovn_u32(b));
+			uint16x8_t const cd = vcombine_u16(vmovn_u32(c), vmovn_u32(d));
+			packed = vcombine_u8(vmovn_u16(ab), vmovn_u16(cd));
+		}
+		vst1q_u8(dst + i, packed);
+	}
+#endif
+	return i;
+}
+
+template<bool Write>
+size_t Utf8ToWideT(char const *text, size_t size, wchar_t *dst) {
+	uint8_t const *src = (uint8_t const *) text;
+	size_t i = 0;
+	size_t out = 0;
+	while (i < size) {
+		if (src[i] < 0x80) {
+			// a run of ASCII, blocks then whatever is left before the next multi byte sequence
+			size_t const block = AsciiToWide<Write>(src + i, size - i, Write ? dst + out : nullptr);
+			i += block;
+			out += block;
+			while (i < size && src[i] < 0x80) {
+				if (Write) dst[out] = (wchar_t) src[i];
+				++i;
+				++out;
+			}
+			continue;
+		}
+
+		// lead byte ranges exclude overlong 2 byte forms (C0, C1) and anything past U+10FFFF (F5+)
+		uint32_t const lead = src[i];
+		size_t const left = size - i;
+		uint32_t c;
+		if (lead >= 0xC2 && lead < 0xE0) {
+			if (left < 2 || (src[i + 1] & 0xC0) != 0x80) return TranscodeError;
+			c = ((lead & 0x1F) << 6) | (src[i + 1] & 0x3F);
+			i += 2;
+		} else if (lead >= 0xE0 && lead < 0xF0) {
+			if (left < 3 || (src[i + 1] & 0xC0) != 0x80 || (src[i + 2] & 0xC0) != 0x80) return TranscodeError;
+			c = ((lead & 0x0F) << 12) | ((src[i + 1] & 0x3F) << 6) | (src[i + 2] & 0x3F);
+			if (c < 0x800 || (c >= 0xD800 && c <= 0xDFFF)) return TranscodeError;
+			i += 3;
+		} else if (lead >= 0xF0 && lead < 0xF5) {
+			if (left < 4 || (src[i + 1] & 0xC0) != 0x80 || (src[i + 2] & 0xC0) != 0x80 || (src[i + 3] & 0xC0) != 0x80) {
+				return TranscodeError;
+			}
+			c = ((lead & 0x07) << 18) | ((src[i + 1] & 0x3F) << 12) | ((src[i + 2] & 0x3F) << 6) | (src[i + 3] & 0x3F);
+			if (c < 0x10000 || c > 0x10FFFF) return TranscodeError;
+			i += 4;
+		} else {
+			return TranscodeError;
+		}
+
+		if (WideIs16Bit && c >= 0x10000) {
+			if (Write) {
+				dst[out + 0] = (wchar_t) (0xD800 + ((c - 0x10000) >> 10));
+				dst[out + 1] = (wchar_t) (0xDC00 + ((c - 0x10000) & 0x3FF));
+			}
+			out += 2;
+		} else {
+			if (Write) dst[out] = (wchar_t) c;
+			out += 1;
+		}
+	}
+	return out;
+}
+
+template<bool Write>
+size_t WideToUtf8T(wchar_t const *src, size_t count, char *text) {
+	uint8_t *dst = (uint8_t *) text;
+	size_t i = 0;
+	size_t out = 0;
+	while (i < count) {
+		uint32_t c = (uint32_t) src[i];
+		if (WideIs16Bit) c &= 0xFFFF;
+		if (c < 0x80) {
+			size_t const block = WideToAscii<Write>(src + i, count - i, Write ? dst + out : nullptr);
+			i += block;
+			out += block;
+			while (i < count && (uint32_t) src[i] < 0x80) {
+				if (Write) dst[out] = (uint8_t) src[i];
+				++i;
+				++out;
+			}
+			continue;
+		}
+
+		++i;
+		if (WideIs16Bit && c >= 0xD800 && c <= 0xDBFF) {
+			if (i == count) return TranscodeError;
+			uint32_t const low = (uint32_t) src[i] & 0xFFFF;
+			if (low < 0xDC00 || low > 0xDFFF) return TranscodeError;
+			c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+			++i;
+		} else if ((c >= 0xD800 && c <= 0xDFFF) || c > 0x10FFFF) {
+			return TranscodeError;
+		}
+
+		if (c < 0x800) {
+			if (Write) {
+				dst[out + 0] = (uint8_t) (0xC0 | (c >> 6));
+				dst[out + 1] = (uint8_t) (0x80 | (c & 0x3F));
+			}
+			out += 2;
+		} else if (c < 0x10000) {
+			if (Write) {
+				dst[out + 0] = (uint8_t) (0xE0 | (c >> 12));
+				dst[out + 1] = (uint8_t) (0x80 | ((c >> 6) & 0x3F));
+				dst[out + 2] = (uint8_t) (0x80 | (c & 0x3F));
+			}
+			out += 3;
+		} else {
+			if (Write) {
+				dst[out + 0] = (uint8_t) (0xF0 | (c >> 18));
+				dst[out + 1] = (uint8_t) (0x80 | ((c >> 12) & 0x3F));
+				dst[out + 2] = (uint8_t) (0x80 | ((c >> 6) & 0x3F));
+				dst[out + 3] = (uint8_t) (0x80 | (c & 0x3F));
+			}
+			out += 4;
+		}
+	}
+	return out;
+}
+
+} // end anon namespace
+
+size_t Utf8ToWide(char const *src, size_t size, wchar_t *dst) {
+	return Utf8ToWideT<true>(src, size, dst);
+}
+
+size_t WideToUtf8(wchar_t const *src, size_t count, char *dst) {
+	return WideToUtf8T<true>(src, count, dst);
+}
+
+size_t Utf8ToWideLength(char const *src, size_t size) {
+	return Utf8ToWideT<false>(src, size, nullptr);
+}
+
+size_t WideToUtf8Length(wchar_t const *src, size_t count) {
+	return WideToUtf8T<false>(src, count, nullptr);
+}
+
+} // namespace ShaderCompiler
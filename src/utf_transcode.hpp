@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ShaderCompiler {
+
+// UTF-8 <-> wchar_t (UTF-16 where wchar_t is 16 bit, UTF-32 elsewhere) without going through the C locale,
+// so it is safe to use from any number of threads. Runs of ASCII, which is nearly all shader text, are
+// converted 16 characters at a time with SSE2 or NEON where available.
+// Invalid input (bad sequences, overlong forms, surrogates, past U+10FFFF) fails with TranscodeError.
+// Input is taken by length, a 0 is converted like any other character and nothing is terminated
+static size_t const TranscodeError = SIZE_MAX;
+
+// output sizes that are enough for any valid input of the given size
+inline size_t Utf8ToWideMaxLength(size_t utf8Size) { return utf8Size; }
+inline size_t WideToUtf8MaxLength(size_t wideCount) { return wideCount * (sizeof(wchar_t) == 2 ? 3 : 4); }
+
+// dst must have room for the max length, returns the number of wchar_t/char written
+size_t Utf8ToWide(char const *src, size_t size, wchar_t *dst);
+size_t WideToUtf8(wchar_t const *src, size_t count, char *dst);
+
+// the exact output size without converting
+size_t Utf8ToWideLength(char const *src, size_t size);
+size_t WideToUtf8Length(wchar_t const *src, size_t count);
+
+} // namespace ShaderCompiler
@@ -0,0 +1,269 @@
+// cache keys and validation, a result is only ever reused for exactly the inputs it was made from
+#include "cache.hpp"
+#include "disk_cache.hpp"
+#include "include_cache.hpp"
+#include "test.hpp"
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+
+using namespace ShaderCompiler;
+
+namespace {
+
+// the includes as they are now, a name that isn't here is missing
+std::map<std::string, Hash128> currentIncludes;
+
+bool ValidateInclude(void *, IncludeDependency const& include) {
+	auto it = currentIncludes.find(include.name);
+	if (it == currentIncludes.end()) return include.contentHash == MissingInclude;
+	return it->second == include.contentHash;
+}
+
+Hash128 HashOf(char const *str) {
+	return Hasher::Of(str, strlen(str));
+}
+
+OutputCache::EntryPtr MakeEntry(char const *shader, std::vector<IncludeDependency> includes) {
+	auto entry = std::make_shared<CachedOutput>();
+	entry->shader.assign(shader, shader + strlen(shader));
+	entry->hasLog = false;
+	entry->succeeded = true;
+	entry->includes = std::move(includes);
+	return entry;
+}
+
+void Hashing() {
+	char const text[] = "float4 main() : SV_Target { return float4(1, 0, 0, 1); } // more than a block or two";
+	size_t const size = sizeof(text) - 1;
+
+	// streamed in pieces that straddle the 16 byte blocks is the same as hashing it in one go
+	for (size_t split = 0; split <= size; ++split) {
+		Hasher hasher;
+		hasher.Add(text, split);
+		hasher.Add(text + split, size - split);
+		CHECK(hasher.Finish() == Hasher::Of(text, size));
+	}
+	CHECK(Hasher::Of(text, size) != Hasher::Of(text, size - 1));
+	CHECK(Hasher(1).Finish() != Hasher(2).Finish());
+
+	// key fields are strings one after the other, moving a character between them must change the key
+	Hasher ab_c, a_bc;
+	ab_c.AddString("ab");
+	ab_c.AddString("c");
+	a_bc.AddString("a");
+	a_bc.AddString("bc");
+	CHECK(ab_c.Finish() != a_bc.Finish());
+
+	// a null string (no define value) and an empty one hash the same
+	Hasher empty, null;
+	empty.AddString("");
+	null.AddString(nullptr);
+	CHECK(empty.Finish() == null.Finish());
+}
+
+void IncludeValidation() {
+	currentIncludes.clear();
+	currentIncludes["common.h"] = HashOf("#define A 1");
+
+	OutputCache cache(1 << 20);
+	Hash128 const key = HashOf("key");
+	// other.h was looked for and not found, common.h was
+	cache.Insert(key, MakeEntry("shader", {{"common.h", HashOf("#define A 1")}, {"other.h", MissingInclude}}));
+
+	OutputCache::EntryPtr hit = cache.Lookup(key, &ValidateInclude, nullptr);
+	CHECK(hit && hit->shader.size() == strlen("shader"));
+	CHECK(!cache.Lookup(HashOf("another key"), &ValidateInclude, nullptr));
+
+	// an include that changes or appears means the result is out of date
+	currentIncludes["common.h"] = HashOf("#define A 2");
+	CHECK(!cache.Lookup(key, &ValidateInclude, nullptr));
+	currentIncludes["common.h"] = HashOf("#define A 1");
+	CHECK(cache.Lookup(key, &ValidateInclude, nullptr));
+	currentIncludes["other.h"] = HashOf("");
+	CHECK(!cache.Lookup(key, &ValidateInclude, nullptr));
+	currentIncludes.erase("other.h");
+
+	ShaderCompiler_CacheStats stats;
+	cache.GetStats(&stats);
+	CHECK(stats.hits == 2);
+	CHECK(stats.misses == 3);
+	CHECK(stats.entryCount == 1);
+}
+
+void Budget() {
+	currentIncludes.clear();
+	OutputCache::EntryPtr const a = MakeEntry("a", {});
+	OutputCache::EntryPtr const b = MakeEntry("b", {});
+	OutputCache::EntryPtr const c = MakeEntry("c", {});
+
+	// room for two entries
+	OutputCache cache(a->Footprint() * 2);
+	cache.Insert(HashOf("a"), a);
+	cache.Insert(HashOf("b"), b);
+	// a is now the most recently used so b goes to make room for c
+	CHECK(cache.Lookup(HashOf("a"), &ValidateInclude, nullptr) == a);
+	cache.Insert(HashOf("c"), c);
+	CHECK(cache.Lookup(HashOf("a"), &ValidateInclude, nullptr) == a);
+	CHECK(!cache.Lookup(HashOf("b"), &ValidateInclude, nullptr));
+	CHECK(cache.Lookup(HashOf("c"), &ValidateInclude, nullptr) == c);
+
+	cache.SetBudget(0);
+	CHECK(!cache.Enabled());
+	CHECK(!cache.Lookup(HashOf("a"), &ValidateInclude, nullptr));
+	cache.Insert(HashOf("a"), a);
+	CHECK(!cache.Lookup(HashOf("a"), &ValidateInclude, nullptr));
+}
+
+// loads the include from includeContents, counting how often it is asked
+std::map<std::string, std::string> includeContents;
+int includeLoads = 0;
+
+class StringBlob : public ShaderConductor::Blob {
+public:
+	explicit StringBlob(std::string contents) : contents(std::move(contents)) {}
+	void const *Data() const override { return contents.data(); }
+	uint32_t Size() const override { return (uint32_t) contents.size(); }
+
+private:
+	std::string contents;
+};
+
+ShaderConductor::Blob *LoadInclude(void *, char const *name) {
+	includeLoads++;
+	auto it = includeContents.find(name);
+	return it == includeContents.end() ? nullptr : new StringBlob(it->second);
+}
+
+void Includes() {
+	includeContents.clear();
+	includeLoads = 0;
+	IncludeCache cache;
+
+	includeContents["a.h"] = "#define A 1";
+	IncludeFilePtr const a = cache.Get("a.h", &LoadInclude, nullptr, false);
+	CHECK(a && a->contentHash == HashOf("#define A 1"));
+	CHECK(cache.Get("a.h", &LoadInclude, nullptr, false) == a);
+	CHECK(includeLoads == 1);
+
+	// a changed include is only seen once it is invalidated, and that starts a new generation
+	includeContents["a.h"] = "#define A 2";
+	uint64_t const generation = cache.Generation();
+	CHECK(cache.Get("a.h", &LoadInclude, nullptr, false) == a);
+	cache.Invalidate("a.h");
+	CHECK(cache.Generation() != generation);
+	CHECK(cache.Get("a.h", &LoadInclude, nullptr, false)->contentHash == HashOf("#define A 2"));
+	CHECK(includeLoads == 2);
+
+	// a miss is remembered until invalidated
+	CHECK(!cache.Get("b.h", &LoadInclude, nullptr, false));
+	includeContents["b.h"] = "";
+	CHECK(!cache.Get("b.h", &LoadInclude, nullptr, false));
+	CHECK(includeLoads == 3);
+	cache.Invalidate("b.h");
+	CHECK(cache.Get("b.h", &LoadInclude, nullptr, false));
+	CHECK(includeLoads == 4);
+}
+
+// includes read from disk aren't invalidated by anyone so have to notice changes themselves
+ShaderConductor::Blob *ReadInclude(void *, char const *path) {
+	includeLoads++;
+	FILE *file = fopen(path, "rb");
+	if (!file) return nullptr;
+	std::string contents;
+	char buffer[256];
+	for (size_t read; (read = fread(buffer, 1, sizeof(buffer), file)) != 0;) contents.append(buffer, read);
+	fclose(file);
+	return new StringBlob(std::move(contents));
+}
+
+void WriteInclude(std::string const& path, char const *contents) {
+	FILE *file = fopen(path.c_str(), "wb");
+	CHECK(file);
+	if (!file) return;
+	fwrite(contents, 1, strlen(contents), file);
+	fclose(file);
+}
+
+void DiskIncludes() {
+	std::string const path = std::string(CACHE_TESTS_DIRECTORY) + "/disk_include.h";
+	remove(path.c_str());
+	includeLoads = 0;
+	IncludeCache cache;
+
+	// a miss is looked for every time, so one that appears later is found
+	CHECK(!cache.Get(path.c_str(), &ReadInclude, nullptr, true));
+	CHECK(!cache.Get(path.c_str(), &ReadInclude, nullptr, true));
+	CHECK(includeLoads == 2);
+	WriteInclude(path, "#define D 1");
+	IncludeFilePtr const first = cache.Get(path.c_str(), &ReadInclude, nullptr, true);
+	CHECK(first && first->contentHash == HashOf("#define D 1"));
+	CHECK(includeLoads == 3);
+
+	// unchanged it is only read once
+	CHECK(cache.Get(path.c_str(), &ReadInclude, nullptr, true) == first);
+	CHECK(includeLoads == 3);
+
+	// edited it is read again, and compiles after see a new generation
+	uint64_t const generation = cache.Generation();
+	WriteInclude(path, "#define D 22");
+	IncludeFilePtr const edited = cache.Get(path.c_str(), &ReadInclude, nullptr, true);
+	CHECK(edited && edited->contentHash == HashOf("#define D 22"));
+	CHECK(cache.Generation() != generation);
+	CHECK(cache.Get(path.c_str(), &ReadInclude, nullptr, true) == edited);
+	CHECK(includeLoads == 4);
+
+	// and deleted it is missing
+	remove(path.c_str());
+	CHECK(!cache.Get(path.c_str(), &ReadInclude, nullptr, true));
+	CHECK(!cache.Get(path.c_str(), &ReadInclude, nullptr, true));
+	CHECK(includeLoads == 6);
+}
+
+void DiskKeys() {
+	std::string const directory = std::string(CACHE_TESTS_DIRECTORY) + "/disk_cache";
+	Hash128 const key = HashOf("key");
+	OutputCache::EntryPtr const entry = MakeEntry("disk shader", {{"common.h", HashOf("#define A 1")}});
+	currentIncludes.clear();
+	currentIncludes["common.h"] = HashOf("#define A 1");
+	{
+		std::unique_ptr<DiskCache> cache = DiskCache::Open(directory.c_str(), "tools 1", 0);
+		CHECK(cache);
+		if (!cache) return;
+		cache->Store(key, *entry);
+		std::shared_ptr<CachedOutput> loaded = cache->Load(key, &ValidateInclude, nullptr);
+		CHECK(loaded && loaded->shader == entry->shader);
+		CHECK(loaded && loaded->includes.size() == 1 && loaded->includes[0].contentHash == HashOf("#define A 1"));
+		CHECK(!cache->Load(HashOf("another key"), &ValidateInclude, nullptr));
+
+		// an entry whose includes have changed since is a miss not a hit
+		currentIncludes["common.h"] = HashOf("#define A 2");
+		CHECK(!cache->Load(key, &ValidateInclude, nullptr));
+		currentIncludes["common.h"] = HashOf("#define A 1");
+		CHECK(cache->Hits() == 1);
+		CHECK(cache->Misses() == 2);
+	}
+	{
+		// reopened by the same compiler it is still there
+		std::unique_ptr<DiskCache> cache = DiskCache::Open(directory.c_str(), "tools 1", 0);
+		CHECK(cache && cache->Load(key, &ValidateInclude, nullptr));
+	}
+	{
+		// a different compiler never gets a result an older one made
+		std::unique_ptr<DiskCache> cache = DiskCache::Open(directory.c_str(), "tools 2", 0);
+		CHECK(cache && !cache->Load(key, &ValidateInclude, nullptr));
+	}
+}
+
+} // end anon namespace
+
+int main() {
+	Hashing();
+	IncludeValidation();
+	Budget();
+	Includes();
+	DiskIncludes();
+	DiskKeys();
+	return TestResult();
+}
@@ -0,0 +1,151 @@
+// identical compiles running at the same time share the first one's result
+#include "single_flight.hpp"
+#include "test.hpp"
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace ShaderCompiler;
+
+namespace {
+
+uint32_t const ThreadCount = 8;
+Hash128 const Key{1, 2};
+
+SingleFlight::EntryPtr MakeResult() {
+	auto entry = std::make_shared<CachedOutput>();
+	entry->shader = {1, 2, 3, 4};
+	entry->hasLog = false;
+	entry->succeeded = true;
+	return entry;
+}
+
+// threads all ask for the same key at once, one becomes the leader and the rest wait for it.
+// the leader holds on until every other thread is waiting (or has given up) so they really coalesce
+template<typename LeaderFunc>
+void Race(LeaderFunc leader, std::atomic<uint32_t>& leaders, std::atomic<uint32_t>& waiters,
+					std::vector<SingleFlight::EntryPtr>& results, std::vector<uint8_t>& succeeded) {
+	SingleFlight flights;
+	std::atomic<uint32_t> started(0);
+	results.assign(ThreadCount, nullptr);
+	succeeded.assign(ThreadCount, 0);
+
+	std::vector<std::thread> threads;
+	for (uint32_t i = 0; i < ThreadCount; ++i) {
+		threads.emplace_back([&, i]() {
+			started++;
+			while (started < ThreadCount) std::this_thread::yield();
+
+			bool ok = false;
+			if (flights.Wait(Key, results[i], ok)) {
+				succeeded[i] = ok;
+				waiters++;
+				return;
+			}
+			leaders++;
+			// give the others time to start waiting
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			leader(flights, results[i], ok);
+			succeeded[i] = ok;
+		});
+	}
+	for (auto& thread : threads) thread.join();
+}
+
+void Coalescing() {
+	std::atomic<uint32_t> leaders(0), waiters(0);
+	std::vector<SingleFlight::EntryPtr> results;
+	std::vector<uint8_t> succeeded;
+	std::atomic<uint32_t> made(0);
+
+	Race([&made](SingleFlight& flights, SingleFlight::EntryPtr& result, bool& ok) {
+		SingleFlightLeader leader(flights, Key);
+		result = MakeResult();
+		ok = true;
+		leader.Finish(true, [&made, &result]() {
+			made++;
+			return result;
+		});
+	}, leaders, waiters, results, succeeded);
+
+	// a thread that only got to Wait after the leader finished leads its own flight, so there can be
+	// more than one leader but nobody goes without a result
+	CHECK(leaders + waiters == ThreadCount);
+	CHECK(leaders >= 1);
+	CHECK(made <= leaders);
+	for (uint32_t i = 0; i < ThreadCount; ++i) {
+		CHECK(succeeded[i]);
+		CHECK(results[i] && results[i]->shader.size() == 4);
+	}
+}
+
+void LeaderThrows() {
+	std::atomic<uint32_t> leaders(0), waiters(0);
+	std::vector<SingleFlight::EntryPtr> results;
+	std::vector<uint8_t> succeeded;
+	std::atomic<uint32_t> caught(0);
+
+	Race([&caught](SingleFlight& flights, SingleFlight::EntryPtr&, bool& ok) {
+		ok = false;
+		try {
+			SingleFlightLeader leader(flights, Key);
+			throw std::runtime_error("compile failed");
+		} catch (std::runtime_error const&) {
+			caught++;
+		}
+	}, leaders, waiters, results, succeeded);
+
+	// the waiters are let go with a failure rather than blocking forever
+	CHECK(caught == leaders);
+	CHECK(leaders + waiters == ThreadCount);
+	for (uint32_t i = 0; i < ThreadCount; ++i) {
+		CHECK(!succeeded[i]);
+		CHECK(!results[i]);
+	}
+}
+
+void MakeResultThrows() {
+	SingleFlight flights;
+	SingleFlight::EntryPtr result;
+	bool ok = true;
+	CHECK(!flights.Wait(Key, result, ok));
+
+	std::atomic<bool> waiting(false), released(false);
+	std::thread waiter([&]() {
+		waiting = true;
+		SingleFlight::EntryPtr waited;
+		bool waitedOk = true;
+		CHECK(flights.Wait(Key, waited, waitedOk));
+		CHECK(!waited && !waitedOk);
+		released = true;
+	});
+	// the flight is already running so the waiter can only miss it by starting after it is finished
+	while (!waiting) std::this_thread::yield();
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	bool threw = false;
+	try {
+		SingleFlightLeader leader(flights, Key);
+		leader.Finish(true, []() -> SingleFlight::EntryPtr { throw std::bad_alloc(); });
+	} catch (std::bad_alloc const&) {
+		threw = true;
+	}
+	waiter.join();
+	CHECK(threw);
+	CHECK(released);
+
+	// the key is free again once finished
+	CHECK(!flights.Wait(Key, result, ok));
+	flights.Finish(Key, true, MakeResult);
+}
+
+} // end anon namespace
+
+int main() {
+	Coalescing();
+	LeaderThrows();
+	MakeResultThrows();
+	return TestResult();
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+// the least a test executable needs, CHECK reports and counts failures and main returns TestResult()
+// so ctest sees them
+#include <cstdio>
+
+namespace {
+int testFailures = 0;
+
+int TestResult() {
+	if (testFailures) printf("%d checks failed\n", testFailures);
+	return testFailures ? 1 : 0;
+}
+} // end anon namespace
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			testFailures++; \
+		} \
+	} while (false)
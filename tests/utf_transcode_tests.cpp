@@ -0,0 +1,272 @@
+// the UTF-8 <-> wchar_t transcoder against a plain one code point at a time reference, with the edge cases
+// placed around the 16 byte blocks the SIMD paths work in
+#include "utf_transcode.hpp"
+#include "test.hpp"
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace ShaderCompiler;
+
+namespace {
+
+bool const WideIs16Bit = sizeof(wchar_t) == 2;
+size_t const Guard = 32;
+wchar_t const WideGuard = (wchar_t) 0x5A5A;
+char const ByteGuard = (char) 0xA5;
+
+void AppendUtf8(std::string& out, uint32_t c) {
+	if (c < 0x80) {
+		out += (char) c;
+	} else if (c < 0x800) {
+		out += (char) (0xC0 | (c >> 6));
+		out += (char) (0x80 | (c & 0x3F));
+	} else if (c < 0x10000) {
+		out += (char) (0xE0 | (c >> 12));
+		out += (char) (0x80 | ((c >> 6) & 0x3F));
+		out += (char) (0x80 | (c & 0x3F));
+	} else {
+		out += (char) (0xF0 | (c >> 18));
+		out += (char) (0x80 | ((c >> 12) & 0x3F));
+		out += (char) (0x80 | ((c >> 6) & 0x3F));
+		out += (char) (0x80 | (c & 0x3F));
+	}
+}
+
+void AppendWide(std::wstring& out, uint32_t c) {
+	if (WideIs16Bit && c >= 0x10000) {
+		out += (wchar_t) (0xD800 + ((c - 0x10000) >> 10));
+		out += (wchar_t) (0xDC00 + ((c - 0x10000) & 0x3FF));
+	} else {
+		out += (wchar_t) c;
+	}
+}
+
+// strict decoder a byte at a time, false for anything that isn't valid UTF-8
+bool ReferenceDecode(std::string const& text, std::vector<uint32_t>& codePoints) {
+	codePoints.clear();
+	uint8_t const *src = (uint8_t const *) text.data();
+	size_t const size = text.size();
+	for (size_t i = 0; i < size;) {
+		uint32_t const lead = src[i];
+		size_t length;
+		uint32_t c, min;
+		if (lead < 0x80) {
+			length = 1, c = lead, min = 0;
+		} else if ((lead & 0xE0) == 0xC0) {
+			length = 2, c = lead & 0x1F, min = 0x80;
+		} else if ((lead & 0xF0) == 0xE0) {
+			length = 3, c = lead & 0x0F, min = 0x800;
+		} else if ((lead & 0xF8) == 0xF0) {
+			length = 4, c = lead & 0x07, min = 0x10000;
+		} else {
+			return false;
+		}
+		if (i + length > size) return false;
+		for (size_t j = 1; j < length; ++j) {
+			if ((src[i + j] & 0xC0) != 0x80) return false;
+			c = (c << 6) | (src[i + j] & 0x3F);
+		}
+		if (c < min || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) return false;
+		codePoints.push_back(c);
+		i += length;
+	}
+	return true;
+}
+
+// converts with both the Length and the Write variant, checks they agree and nothing past the output is touched.
+// returns TranscodeError or the converted text in out
+size_t ToWide(std::string const& text, std::wstring& out) {
+	size_t const max = Utf8ToWideMaxLength(text.size());
+	std::vector<wchar_t> buffer(max + Guard, WideGuard);
+	size_t const written = Utf8ToWide(text.data(), text.size(), buffer.data());
+	size_t const length = Utf8ToWideLength(text.data(), text.size());
+	CHECK(written == length);
+	for (size_t i = max; i < buffer.size(); ++i) CHECK(buffer[i] == WideGuard);
+	if (written == TranscodeError) return written;
+	CHECK(written <= max);
+	out.assign(buffer.data(), written);
+	return written;
+}
+
+size_t ToUtf8(std::wstring const& text, std::string& out) {
+	size_t const max = WideToUtf8MaxLength(text.size());
+	std::vector<char> buffer(max + Guard, ByteGuard);
+	size_t const written = WideToUtf8(text.data(), text.size(), buffer.data());
+	size_t const length = WideToUtf8Length(text.data(), text.size());
+	CHECK(written == length);
+	for (size_t i = max; i < buffer.size(); ++i) CHECK(buffer[i] == ByteGuard);
+	if (written == TranscodeError) return written;
+	CHECK(written <= max);
+	out.assign(buffer.data(), written);
+	return written;
+}
+
+// padding that puts what follows at a given offset into a block, long enough to take a block or two
+std::string AsciiPadding(size_t size) {
+	std::string padding;
+	for (size_t i = 0; i < size; ++i) padding += (char) ('a' + (i % 26));
+	return padding;
+}
+
+// every width of sequence at every offset around two block boundaries, converted there and back
+void RoundTrips() {
+	uint32_t const codePoints[] = {0x0, 0x7F, 0x80, 0x7FF, 0x800, 0xD7FF, 0xE000, 0xFFFF, 0x10000, 0x1F600, 0x10FFFF};
+	for (uint32_t c : codePoints) {
+		for (size_t offset = 0; offset < 40; ++offset) {
+			std::string const padding = AsciiPadding(offset);
+			std::wstring const widePadding(padding.begin(), padding.end());
+			std::string utf8 = padding;
+			std::wstring wide = widePadding;
+			AppendUtf8(utf8, c);
+			AppendWide(wide, c);
+			utf8 += padding;
+			wide += widePadding;
+
+			std::wstring toWide;
+			CHECK(ToWide(utf8, toWide) == wide.size());
+			CHECK(toWide == wide);
+			std::string toUtf8;
+			CHECK(ToUtf8(wide, toUtf8) == utf8.size());
+			CHECK(toUtf8 == utf8);
+		}
+	}
+
+	std::wstring empty;
+	std::string emptyUtf8;
+	CHECK(ToWide("", empty) == 0);
+	CHECK(ToUtf8(L"", emptyUtf8) == 0);
+}
+
+// an invalid UTF-8 sequence fails wherever it lands in a block
+void RejectedUtf8(std::string const& sequence) {
+	for (size_t offset = 0; offset < 40; ++offset) {
+		std::string text = AsciiPadding(offset) + sequence + AsciiPadding(17);
+		std::wstring out;
+		CHECK(ToWide(text, out) == TranscodeError);
+	}
+	// and at the very end (where a truncated sequence is most likely)
+	std::wstring out;
+	CHECK(ToWide(AsciiPadding(31) + sequence, out) == TranscodeError);
+}
+
+void RejectedWide(std::wstring const& sequence) {
+	for (size_t offset = 0; offset < 40; ++offset) {
+		std::string const padding = AsciiPadding(offset);
+		std::wstring text(padding.begin(), padding.end());
+		text += sequence;
+		text += L"abcdefghijklmnopq";
+		std::string out;
+		CHECK(ToUtf8(text, out) == TranscodeError);
+	}
+}
+
+void InvalidUtf8() {
+	// overlong forms of '/', U+7FF and U+FFFF
+	RejectedUtf8("\xC0\xAF");
+	RejectedUtf8("\xC1\xBF");
+	RejectedUtf8("\xE0\x80\xAF");
+	RejectedUtf8("\xE0\x9F\xBF");
+	RejectedUtf8("\xF0\x80\x80\xAF");
+	RejectedUtf8("\xF0\x8F\xBF\xBF");
+
+	// UTF-16 surrogates encoded directly
+	RejectedUtf8("\xED\xA0\x80");
+	RejectedUtf8("\xED\xAF\xBF");
+	RejectedUtf8("\xED\xB0\x80");
+	RejectedUtf8("\xED\xBF\xBF");
+
+	// past U+10FFFF
+	RejectedUtf8("\xF4\x90\x80\x80");
+	RejectedUtf8("\xF5\x80\x80\x80");
+	RejectedUtf8("\xF7\xBF\xBF\xBF");
+	RejectedUtf8("\xF8\x88\x80\x80\x80");
+	RejectedUtf8("\xFF");
+
+	// truncated, and a continuation byte where a lead is expected
+	RejectedUtf8("\xC3");
+	RejectedUtf8("\xE2\x82");
+	RejectedUtf8("\xE2");
+	RejectedUtf8("\xF0\x9F\x98");
+	RejectedUtf8("\xF0\x9F");
+	RejectedUtf8("\xF0");
+	RejectedUtf8("\xC3\x41");
+	RejectedUtf8("\xE2\x41\xAC");
+	RejectedUtf8("\x80");
+	RejectedUtf8("\xBF");
+}
+
+void InvalidWide() {
+	if (WideIs16Bit) {
+		// a lone high surrogate (then ASCII), a lone low one and a pair the wrong way round
+		RejectedWide(std::wstring(1, (wchar_t) 0xD800));
+		RejectedWide(std::wstring(1, (wchar_t) 0xDBFF));
+		RejectedWide(std::wstring(1, (wchar_t) 0xDC00));
+		RejectedWide(std::wstring(1, (wchar_t) 0xDFFF));
+		RejectedWide(std::wstring{(wchar_t) 0xDC00, (wchar_t) 0xD800});
+
+		// a high surrogate as the very last character
+		std::string out;
+		CHECK(ToUtf8(std::wstring(20, L'a') + (wchar_t) 0xD83D, out) == TranscodeError);
+	} else {
+		// surrogates aren't characters in UTF-32 and there is nothing past U+10FFFF
+		RejectedWide(std::wstring(1, (wchar_t) 0xD800));
+		RejectedWide(std::wstring(1, (wchar_t) 0xDFFF));
+		RejectedWide(std::wstring{(wchar_t) 0xD83D, (wchar_t) 0xDE00});
+		RejectedWide(std::wstring(1, (wchar_t) 0x110000));
+		RejectedWide(std::wstring(1, (wchar_t) 0x7FFFFFFF));
+	}
+}
+
+// random mixes of ASCII runs, valid sequences and the odd random byte against the reference decoder
+void Random() {
+	std::mt19937 random(12345);
+	uint32_t const ranges[][2] = {{0x80, 0x7FF}, {0x800, 0xD7FF}, {0xE000, 0xFFFF}, {0x10000, 0x10FFFF}};
+
+	for (uint32_t test = 0; test < 20000; ++test) {
+		std::string text;
+		uint32_t const pieces = random() % 12;
+		for (uint32_t p = 0; p < pieces; ++p) {
+			switch (random() % 4) {
+			case 0: text += AsciiPadding(random() % 40);
+				break;
+			case 1:
+			case 2: {
+				uint32_t const *range = ranges[random() % 4];
+				AppendUtf8(text, range[0] + random() % (range[1] - range[0] + 1));
+				break;
+			}
+			default:
+				// mostly makes it invalid, sometimes not
+				text += (char) (random() & 0xFF);
+				break;
+			}
+		}
+
+		std::vector<uint32_t> codePoints;
+		bool const valid = ReferenceDecode(text, codePoints);
+		std::wstring wide;
+		size_t const converted = ToWide(text, wide);
+		CHECK(valid == (converted != TranscodeError));
+		if (!valid || converted == TranscodeError) continue;
+
+		std::wstring expected;
+		for (uint32_t c : codePoints) AppendWide(expected, c);
+		CHECK(wide == expected);
+		std::string back;
+		CHECK(ToUtf8(wide, back) == text.size());
+		CHECK(back == text);
+	}
+}
+
+} // end anon namespace
+
+int main() {
+	RoundTrips();
+	InvalidUtf8();
+	InvalidWide();
+	Random();
+	return TestResult();
+}